@@ -1,11 +1,7 @@
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
-#include "common/Rectangle.h"
-#include "common/SDL_utils.h"
-#include "common/Random.h"
-#include "common/Line.h"
-
 #include "panicfire/ai/AI.h"
 
 using namespace Common;
@@ -17,13 +13,18 @@ namespace PanicFire {
 namespace AI {
 
 // AIData
-AIData::AIData(Common::WorldInterface& w)
+AIData::AIData(Common::WorldInterface& w, Common::TeamID tid, uint64_t seed)
 	: mWorld(w),
-	mMyTeamID(TeamID(2)),
+	mMyTeamID(tid),
 	mGameOver(false),
-	mMyTurn(false)
+	mMyTurn(false),
+	mFinishSent(false),
+	mRng(seed, RngStream::AI, tid.id),
+	mNodeLimit(false),
+	mNodesLeft(0),
+	mDeadline(std::chrono::steady_clock::time_point::max())
 {
-	if(!mData.sync(mWorld))
+	if(!mData.sync(mWorld, mMyTeamID))
 		throw std::runtime_error("Fail on sync data");
 
 	mTeamPlan.setAIData(this);
@@ -33,8 +34,41 @@ AIData::AIData(Common::WorldInterface& w)
 
 void AIData::updateCurrentSoldier()
 {
-	mData.syncCurrentSoldier(mWorld);
-	mMyTurn = mData.getCurrentTeamID() == mMyTeamID;
+	// during the other team's turn our copy of its soldiers must only
+	// be moved by its events, so don't sync the current soldier yet
+	QueryResult qr = mWorld.query(CurrentSoldierQuery());
+	const CurrentSoldierQueryResult* cq = boost::get<CurrentSoldierQueryResult>(&qr);
+	if(!cq)
+		throw std::runtime_error("Current soldier query failed");
+	mMyTurn = cq->team == mMyTeamID;
+	if(mMyTurn)
+		mData.syncCurrentSoldier(mWorld, mMyTeamID);
+}
+
+bool AIData::finishTurn()
+{
+	bool succ = mWorld.input(FinishTurnInput());
+	if(succ)
+		mFinishSent = true;
+	return succ;
+}
+
+void AIData::startBudget(const AIBudget& b)
+{
+	mNodeLimit = b.nodes != 0;
+	mNodesLeft = b.nodes;
+	if(b.time.count())
+		mDeadline = std::chrono::steady_clock::now() + b.time;
+	else
+		mDeadline = std::chrono::steady_clock::time_point::max();
+}
+
+bool AIData::budgetLeft() const
+{
+	if(mNodeLimit && mNodesLeft == 0)
+		return false;
+	return mDeadline == std::chrono::steady_clock::time_point::max() ||
+		std::chrono::steady_clock::now() < mDeadline;
 }
 
 // TeamPlan
@@ -64,14 +98,14 @@ Position TeamPlan::getNextVisitPosition() const
 		}
 		unsigned int numPositions = w * h / 20;
 		for(unsigned int i = 0; i < numPositions; i++) {
-			mVisitPositions.insert(Position(Random::uniform(0, w),
-						Random::uniform(0, h)));
+			mVisitPositions.insert(Position(mAIData->mRng.uniform(0, w),
+						mAIData->mRng.uniform(0, h)));
 		}
 	}
 
 	assert(!mVisitPositions.empty());
 	unsigned int mmax = mVisitPositions.size();
-	unsigned int t = Random::uniform(0, mmax);
+	unsigned int t = mAIData->mRng.uniform(0, mmax);
 	for(std::set<Position>::const_iterator it = mVisitPositions.begin(); it != mVisitPositions.end(); ++it) {
 		if(t == 0) {
 			Position p = *it;
@@ -95,26 +129,66 @@ SoldierPlan::SoldierPlan(AIData& d, SoldierID i)
 	mTargetPosition = mAIData.mData.getSoldier(mID)->position;
 }
 
-void SoldierPlan::act()
+bool SoldierPlan::act()
 {
+	// always take at least one step so that each call makes progress
+	// the events may hand the turn back to us with another soldier,
+	// which is up to the next call
+	bool stepped = false;
 	do {
 		handleEvents();
-		if(mAIData.mMyTurn) {
+		if(myTurn()) {
+			if(stepped && !mAIData.budgetLeft())
+				return false;
 			checkShotChance();
 			sendInput();
+			stepped = true;
 		}
-	} while(mAIData.mMyTurn);
+	} while(myTurn());
+	return true;
+}
+
+bool SoldierPlan::myTurn() const
+{
+	return mAIData.mMyTurn && mAIData.mData.getCurrentSoldierID() == mID;
+}
+
+std::vector<Common::Position> SoldierPlan::findPath(const Common::Position& from,
+		const Common::Position& to)
+{
+	// no node limit left must not turn into an unlimited search
+	if(mAIData.mNodeLimit && mAIData.mNodesLeft == 0)
+		return std::vector<Common::Position>();
+
+	auto path = mAIData.mAStar.solve(mAIData.mData.getSoldierPositions(),
+			from, to, mAIData.mNodeLimit ? mAIData.mNodesLeft : 0,
+			mAIData.mDeadline);
+	if(mAIData.mNodeLimit) {
+		unsigned int n = mAIData.mAStar.getExpandedNodes();
+		mAIData.mNodesLeft -= std::min(n, mAIData.mNodesLeft);
+	}
+	return path;
 }
 
 void SoldierPlan::setupPath()
 {
 	auto sd = mAIData.mData.getSoldier(mID);
-	if(sd->position == mTargetPosition) {
-		do {
+	if(!mPath.empty() && mPath.back() == sd->position && sd->position != mTargetPosition) {
+		// the search was cut short last time - keep going to the same target
+		mPath = findPath(sd->position, mTargetPosition);
+		if(mPath.size() > 1)
+			return;
+		mPath.clear();
+	}
+
+	if(sd->position == mTargetPosition || mPath.empty()) {
+		// give up after a while in case the soldier is boxed in
+		for(int tries = 0; tries < 100 && mAIData.budgetLeft(); tries++) {
 			mTargetPosition = mAIData.mTeamPlan.getNextVisitPosition();
-			mPath = mAIData.mAStar.solve(mAIData.mData.getSoldierPositions(),
-					sd->position, mTargetPosition);
-		} while(mPath.empty());
+			mPath = findPath(sd->position, mTargetPosition);
+			if(!mPath.empty())
+				break;
+		}
 	}
 }
 
@@ -124,15 +198,26 @@ void SoldierPlan::sendInput()
 	if(mShooting) {
 		bool succ = mAIData.mWorld.input(ShotInput(mID, mShootPosition));
 		if(!succ) {
-			bool succ = mAIData.mWorld.input(FinishTurnInput());
+			bool succ = mAIData.finishTurn();
 			assert(succ);
 		} else {
 			mSentInput = true;
 		}
 	} else {
 		if(mPath.empty() || *mPath.begin() == sd->position) {
+			// out of budget - try again on the next call, which can
+			// still carry on with a search that was cut short
+			if(!mAIData.budgetLeft())
+				return;
 			setupPath();
-			assert(!mPath.empty());
+			if(mPath.empty()) {
+				// out of budget - try again on the next call
+				if(!mAIData.budgetLeft())
+					return;
+				bool succ = mAIData.finishTurn();
+				assert(succ);
+				return;
+			}
 		}
 
 		for(auto pit = mPath.begin(); pit != mPath.end(); ) {
@@ -141,11 +226,16 @@ void SoldierPlan::sendInput()
 			} else {
 				MovementInput i(mID, sd->position, *pit);
 				if(mAIData.mData.movementAllowed(i)) {
-					bool succ = mAIData.mWorld.input(i);
-					assert(succ);
-					mSentInput = true;
+					if(mAIData.mWorld.input(i)) {
+						mSentInput = true;
+					} else {
+						// an enemy we don't see is in the way
+						mPath.clear();
+						bool succ = mAIData.finishTurn();
+						assert(succ);
+					}
 				} else {
-					bool succ = mAIData.mWorld.input(FinishTurnInput());
+					bool succ = mAIData.finishTurn();
 					assert(succ);
 				}
 				break;
@@ -156,18 +246,16 @@ void SoldierPlan::sendInput()
 
 void SoldierPlan::handleEvents()
 {
-	while(1) {
-		auto ev = mAIData.mWorld.pollEvents(mAIData.mMyTeamID);
-		bool empty = boost::apply_visitor(mAIData.mData, ev);
-		if(empty)
-			break;
+	mAIData.mEvents.clear();
+	mAIData.mWorld.pollEvents(mAIData.mMyTeamID, mAIData.mEvents);
+	for(auto& ev : mAIData.mEvents) {
+		boost::apply_visitor(mAIData.mData, ev);
 		boost::apply_visitor(*this, ev);
 	}
 }
 
 void SoldierPlan::checkShotChance()
 {
-	auto mysd = mAIData.mData.getSoldier(mID);
 	mShooting = false;
 
 	static_assert(MAX_NUM_TEAMS == 2, "Only two teams supported");
@@ -176,28 +264,11 @@ void SoldierPlan::checkShotChance()
 	assert(td);
 	for(auto sid : td->soldiers) {
 		auto sd = mAIData.mData.getSoldier(sid);
-		if(sd && sd->alive()) {
-			auto l = Line::line(Point2(mysd->position.x, mysd->position.y),
-					Point2(sd->position.x, sd->position.y));
-			assert(l.size() >= 2);
-			l.pop_front(); // shooter position
-			l.pop_front(); // first position next to shooter
-			if(!l.empty())
-				l.pop_back(); // target location
-			const auto mapdata = mAIData.mData.getMapData();
-			bool blocked = false;
-			for(auto& p : l) {
-				Position pp(p.x, p.y);
-				if(mapdata->positionBlocked(pp) || mAIData.mData.getSoldierAt(pp)) {
-					blocked = true;
-					break;
-				}
-			}
-			if(!blocked) {
-				mShootPosition = sd->position;
-				mShooting = true;
-				break;
-			}
+		// the matrix is false for dead soldiers
+		if(sd && mAIData.mSighted.count(sid) && mAIData.mData.inLineOfFire(mID, sid)) {
+			mShootPosition = sd->position;
+			mShooting = true;
+			break;
 		}
 	}
 }
@@ -209,6 +280,10 @@ void SoldierPlan::operator()(const Common::InputEvent& ev)
 
 void SoldierPlan::operator()(const Common::SightingEvent& ev)
 {
+	if(ev.visible)
+		mAIData.mSighted.insert(ev.seen);
+	else
+		mAIData.mSighted.erase(ev.seen);
 }
 
 void SoldierPlan::operator()(const Common::SoldierWoundedEvent& ev)
@@ -243,11 +318,18 @@ void SoldierPlan::operator()(const Common::ShotInput& ev)
 
 void SoldierPlan::operator()(const Common::FinishTurnInput& ev)
 {
-	mAIData.updateCurrentSoldier();
+	if(mAIData.mFinishSent) {
+		// our own turn is over, whatever the world has moved on to
+		// by now
+		mAIData.mFinishSent = false;
+		mAIData.mMyTurn = false;
+	} else {
+		mAIData.updateCurrentSoldier();
+	}
 }
 
-AI::AI(Common::WorldInterface& w)
-	: mAIData(w)
+AI::AI(Common::WorldInterface& w, Common::TeamID tid, uint64_t seed)
+	: mAIData(w, tid, seed)
 {
 }
 
@@ -255,17 +337,22 @@ AI::~AI()
 {
 }
 
-void AI::act()
+bool AI::act(const AIBudget& budget)
 {
+	mAIData.startBudget(budget);
 	mAIData.updateCurrentSoldier();
 
-	if(mAIData.mGameOver)
-		return;
+	if(mAIData.mGameOver || !mAIData.mMyTurn)
+		return true;
+
+	// the game may be over with the GameWonEvent still queued
+	if(!mAIData.mData.getCurrentSoldier().alive())
+		return true;
 
-	sendInput();
+	return sendInput();
 }
 
-void AI::sendInput()
+bool AI::sendInput()
 {
 	auto sd = mAIData.mData.getCurrentSoldier();
 	assert(sd.teamid == mAIData.mData.getCurrentTeamID());
@@ -275,7 +362,7 @@ void AI::sendInput()
 	if(it == mAIData.mSoldierPlan.end()) {
 		it = mAIData.mSoldierPlan.insert({sd.id, SoldierPlan(mAIData, sd.id)}).first;
 	}
-	it->second.act();
+	return it->second.act();
 }
 
 
@@ -2,11 +2,11 @@
 #define PANICFIRE_AI_AI_H
 
 #include <array>
-
-#include "common/Color.h"
-#include "common/Vector2.h"
-#include "common/Texture.h"
-#include "common/DriverFramework.h"
+#include <chrono>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
 
 #include "panicfire/common/Structures.h"
 
@@ -18,6 +18,15 @@ namespace AI {
 
 struct AIData;
 
+// Bounds the work done by one AI::act call. Zero means no limit.
+struct AIBudget {
+	AIBudget(unsigned int nodes_ = 0,
+			std::chrono::microseconds time_ = std::chrono::microseconds(0))
+		: nodes(nodes_), time(time_) { }
+	unsigned int nodes; // A* node expansions
+	std::chrono::microseconds time;
+};
+
 class TeamPlan {
 	public:
 		TeamPlan();
@@ -46,12 +55,17 @@ class SoldierPlan : public boost::static_visitor<> {
 		void operator()(const Common::ShotInput& ev);
 		void operator()(const Common::FinishTurnInput& ev);
 
-		void act();
+		// returns false if the budget ran out before the turn was over
+		bool act();
 
 	private:
 		void syncSoldierData();
 		void handleEvents();
+		// whether it's still this soldier's turn
+		bool myTurn() const;
 		void setupPath();
+		std::vector<Common::Position> findPath(const Common::Position& from,
+				const Common::Position& to);
 		void sendInput();
 		void checkShotChance();
 
@@ -61,12 +75,15 @@ class SoldierPlan : public boost::static_visitor<> {
 		Common::Position mTargetPosition;
 		Common::Position mShootPosition;
 		bool mShooting;
-		std::list<Common::Position> mPath;
+		std::vector<Common::Position> mPath;
 };
 
 struct AIData {
-	AIData(Common::WorldInterface& w);
+	AIData(Common::WorldInterface& w, Common::TeamID tid, uint64_t seed);
 	void updateCurrentSoldier();
+	bool finishTurn();
+	void startBudget(const AIBudget& b);
+	bool budgetLeft() const;
 
 	Common::WorldInterface& mWorld;
 	Common::WorldData mData;
@@ -76,17 +93,31 @@ struct AIData {
 	bool mGameOver;
 	TeamPlan mTeamPlan;
 	bool mMyTurn;
+	bool mFinishSent; // our FinishTurnInput event is still to come
+	Common::Rng mRng;
+	std::vector<Common::Event> mEvents;
+	// the enemy soldiers in sight; the others may not be where mData
+	// last saw them
+	std::set<Common::SoldierID> mSighted;
+	// what's left of the budget of the current act() call
+	bool mNodeLimit;
+	unsigned int mNodesLeft;
+	std::chrono::steady_clock::time_point mDeadline;
 };
 
 class AI {
 	public:
-		AI(Common::WorldInterface& w);
+		AI(Common::WorldInterface& w, Common::TeamID tid = Common::TeamID(2),
+				uint64_t seed = 0);
 		~AI();
 
-		void act();
+		// Plays the AI's turn if it's its turn. Returns false if the
+		// budget ran out first; the next call then carries on where
+		// this one stopped.
+		bool act(const AIBudget& budget = AIBudget());
 
 	private:
-		void sendInput();
+		bool sendInput();
 		void sendEndOfTurn();
 
 		AIData mAIData;
@@ -0,0 +1,104 @@
+#include <stdexcept>
+
+#include "panicfire/ai/AsyncAI.h"
+
+namespace PanicFire {
+
+namespace AI {
+
+AsyncAI::AsyncAI(Common::WorldInterface& w, Common::TeamID tid, uint64_t seed,
+		const AIBudget& budget)
+	: mWorld(w),
+	mTeamID(tid),
+	mSeed(seed),
+	mBudget(budget),
+	mTurnRequested(false),
+	mStop(false),
+	mBusy(true)
+{
+	// busy until the worker has synced its world data
+	mThread = std::thread(&AsyncAI::run, this);
+}
+
+AsyncAI::~AsyncAI()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mCond.notify_one();
+	mThread.join();
+}
+
+void AsyncAI::startTurn()
+{
+	if(mBusy)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mError)
+			return;
+		mTurnRequested = true;
+		mBusy = true;
+	}
+	mCond.notify_one();
+}
+
+bool AsyncAI::busy() const
+{
+	return mBusy;
+}
+
+bool AsyncAI::failed() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return bool(mError);
+}
+
+void AsyncAI::rethrow() const
+{
+	std::exception_ptr e;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		e = mError;
+	}
+	if(e)
+		std::rethrow_exception(e);
+}
+
+void AsyncAI::run()
+{
+	try {
+		AI ai(mWorld, mTeamID, mSeed);
+		mBusy = false;
+
+		while(1) {
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCond.wait(lock, [this]() { return mStop || mTurnRequested; });
+				if(mStop)
+					return;
+				mTurnRequested = false;
+			}
+
+			while(!ai.act(mBudget)) {
+				std::lock_guard<std::mutex> lock(mMutex);
+				if(mStop)
+					return;
+			}
+			mBusy = false;
+		}
+	}
+	catch(...) {
+		// not busy any more, so that the caller doesn't wait forever
+		std::lock_guard<std::mutex> lock(mMutex);
+		mError = std::current_exception();
+		mBusy = false;
+	}
+}
+
+}
+
+}
+
@@ -0,0 +1,63 @@
+#ifndef PANICFIRE_AI_ASYNCAI_H
+#define PANICFIRE_AI_ASYNCAI_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+#include "panicfire/common/Structures.h"
+
+#include "panicfire/ai/AI.h"
+
+namespace PanicFire {
+
+namespace AI {
+
+// Runs an AI on a worker thread so that the caller (e.g. the render
+// loop) never waits for it. The world interface must be safe to use
+// from the worker thread, e.g. a Game::ChannelClient. The moves the AI
+// makes reach the caller as events through its own world interface.
+// The AI works in slices of the given budget and checks for shutdown
+// between them.
+class AsyncAI {
+	public:
+		AsyncAI(Common::WorldInterface& w, Common::TeamID tid, uint64_t seed = 0,
+				const AIBudget& budget = AIBudget());
+		~AsyncAI();
+		AsyncAI(const AsyncAI&) = delete;
+		AsyncAI& operator=(const AsyncAI&) = delete;
+
+		// asks the AI to play its turn; returns immediately and does
+		// nothing if the AI is still busy or has failed
+		void startTurn();
+		bool busy() const;
+		// whether the worker stopped on an exception, which rethrow()
+		// throws on the calling thread
+		bool failed() const;
+		void rethrow() const;
+
+	private:
+		void run();
+
+		Common::WorldInterface& mWorld;
+		Common::TeamID mTeamID;
+		uint64_t mSeed;
+		AIBudget mBudget;
+
+		mutable std::mutex mMutex;
+		std::condition_variable mCond;
+		std::exception_ptr mError;
+		bool mTurnRequested;
+		bool mStop;
+		std::atomic<bool> mBusy;
+		std::thread mThread;
+};
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,530 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <new>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <sstream>
+
+#include "common/Line.h"
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/common/Checkpoint.h"
+#include "panicfire/common/MapCodec.h"
+#include "panicfire/common/MapFile.h"
+#include "panicfire/common/ChunkedMap.h"
+#include "panicfire/common/LineWalker.h"
+#include "panicfire/common/FieldOfView.h"
+#include "panicfire/game/World.h"
+#include "panicfire/game/Vision.h"
+#include "panicfire/ui/AStar.h"
+
+using namespace PanicFire;
+using namespace PanicFire::Common;
+
+// allocation counting - the benchmarks are single threaded
+static unsigned long long gAllocations = 0;
+
+void* operator new(size_t n)
+{
+	gAllocations++;
+	void* p = malloc(n ? n : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void* operator new[](size_t n)
+{
+	return operator new(n);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+static const unsigned int NumRounds = 5;
+static const char* gFilter = nullptr;
+
+// keeps the compiler from optimising away benchmarked calls
+static volatile unsigned int gSink = 0;
+
+static void report(const char* name, double nsperop, double allocsperop)
+{
+	printf("%-44s %14.1f ns/op %10.2f allocs/op\n", name, nsperop, allocsperop);
+	fflush(stdout);
+}
+
+// Runs op iters times per round and reports the median round.
+static void bench(const char* name, unsigned int iters, const std::function<void ()>& op)
+{
+	if(gFilter && !strstr(name, gFilter))
+		return;
+
+	op(); // warm up
+	std::vector<double> ns;
+	unsigned long long allocs = 0;
+	for(unsigned int r = 0; r < NumRounds; r++) {
+		gAllocations = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(unsigned int i = 0; i < iters; i++)
+			op();
+		auto end = std::chrono::steady_clock::now();
+		allocs = gAllocations;
+		ns.push_back(std::chrono::duration<double, std::nano>(end - start).count() / iters);
+	}
+	std::sort(ns.begin(), ns.end());
+	report(name, ns[NumRounds / 2], double(allocs) / iters);
+}
+
+// Like bench() but calls setup before each op without timing it.
+static void bench(const char* name, unsigned int iters,
+		const std::function<void ()>& setup,
+		const std::function<void ()>& op)
+{
+	if(gFilter && !strstr(name, gFilter))
+		return;
+
+	setup();
+	op();
+	std::vector<double> ns;
+	unsigned long long allocs = 0;
+	for(unsigned int r = 0; r < NumRounds; r++) {
+		double total = 0.0;
+		allocs = 0;
+		for(unsigned int i = 0; i < iters; i++) {
+			setup();
+			unsigned long long a = gAllocations;
+			auto start = std::chrono::steady_clock::now();
+			op();
+			auto end = std::chrono::steady_clock::now();
+			allocs += gAllocations - a;
+			total += std::chrono::duration<double, std::nano>(end - start).count();
+		}
+		ns.push_back(total / iters);
+	}
+	std::sort(ns.begin(), ns.end());
+	report(name, ns[NumRounds / 2], double(allocs) / iters);
+}
+
+// random map where a share of the tiles given by density is blocked
+static MapData makeMap(unsigned int w, unsigned int h, float density, uint64_t seed)
+{
+	MapData m;
+	Rng rng(seed, RngStream::Map);
+	m.generate(w, h, rng);
+	int limit = density * 1000;
+	for(unsigned int j = 0; j < h; j++) {
+		for(unsigned int i = 0; i < w; i++) {
+			MapFragment f = m.getPoint(i, j);
+			f.vegetationlevel = rng.uniform(0, 1000) < limit ? VegetationLevel::Rock : VegetationLevel::None;
+			m.setPoint(i, j, f);
+		}
+	}
+	return m;
+}
+
+static void benchAStar()
+{
+	const unsigned int sizes[] = { 24, 64, 256 };
+	const float densities[] = { 0.0f, 0.15f, 0.3f };
+	for(auto size : sizes) {
+		for(auto density : densities) {
+			MapData m = makeMap(size, size, density, 1);
+			Bitset occupied(size * size);
+			UI::AStar astar;
+			astar.setMapData(&m);
+
+			// fixed set of queries between free tiles
+			Rng rng(2, RngStream::AI);
+			std::vector<std::pair<Position, Position>> queries;
+			while(queries.size() < 64) {
+				Position a(rng.uniform(0, size), rng.uniform(0, size));
+				Position b(rng.uniform(0, size), rng.uniform(0, size));
+				if(!m.positionBlocked(a) && !m.positionBlocked(b))
+					queries.push_back({a, b});
+			}
+
+			char name[64];
+			snprintf(name, sizeof(name), "AStar::solve %ux%u %.0f%% blocked",
+					size, size, density * 100.0f);
+			unsigned int qi = 0;
+			bench(name, size >= 256 ? 64 : 512, [&]() {
+				auto& q = queries[qi++ % queries.size()];
+				gSink += astar.solve(occupied, q.first, q.second).size();
+			});
+
+			// partial paths as used by the budgeted AI
+			snprintf(name, sizeof(name), "AStar::solve %ux%u %.0f%% blocked, 256 nodes",
+					size, size, density * 100.0f);
+			bench(name, 512, [&]() {
+				auto& q = queries[qi++ % queries.size()];
+				gSink += astar.solve(occupied, q.first, q.second, 256).size();
+			});
+		}
+	}
+}
+
+// skipped if the benchmark was filtered out
+static void reportTraceCache(const WorldData& wd)
+{
+	const TraceCache& tc = wd.getTraceCache();
+	if(tc.getHits() + tc.getMisses()) {
+		printf("  trace cache: %llu hits, %llu misses\n",
+				(unsigned long long)tc.getHits(), (unsigned long long)tc.getMisses());
+	}
+}
+
+static void benchLine()
+{
+	Rng rng(3, RngStream::AI);
+	std::vector<std::pair<Position, Position>> lines;
+	for(int i = 0; i < 64; i++) {
+		lines.push_back({Position(rng.uniform(0, 24), rng.uniform(0, 24)),
+				Position(rng.uniform(0, 24), rng.uniform(0, 24))});
+	}
+	unsigned int li = 0;
+	bench("Line::line 24x24", 100000, [&]() {
+		auto& l = lines[li++ % lines.size()];
+		gSink += ::Common::Line::line(::Common::Point2(l.first.x, l.first.y),
+				::Common::Point2(l.second.x, l.second.y)).size();
+	});
+
+	bench("LineWalker 24x24", 100000, [&]() {
+		auto& l = lines[li++ % lines.size()];
+		LineWalker w(l.first, l.second);
+		unsigned int n = 1;
+		while(!w.atEnd()) {
+			w.next();
+			n++;
+		}
+		gSink += n;
+	});
+
+	// the same few lines over and over, which the trace cache keeps
+	WorldData wd(24, 24, MAX_TEAM_SOLDIERS, 3);
+	bench("WorldData::traceShot cached 24x24", 100000, [&]() {
+		auto& l = lines[li++ % lines.size()];
+		gSink += wd.traceShot(l.first, l.second).x;
+	});
+	reportTraceCache(wd);
+
+	// far more lines than the cache has room for
+	WorldData wd2(24, 24, MAX_TEAM_SOLDIERS, 3);
+	bench("WorldData::traceShot random 24x24", 100000, [&]() {
+		gSink += wd2.traceShot(Position(rng.uniform(0, 24), rng.uniform(0, 24)),
+				Position(rng.uniform(0, 24), rng.uniform(0, 24))).x;
+	});
+	reportTraceCache(wd2);
+}
+
+static void benchWorldData()
+{
+	WorldData wd(24, 24, MAX_TEAM_SOLDIERS, 4);
+	unsigned int i = 0;
+	bench("WorldData::getSoldierAt", 1000000, [&]() {
+		gSink += wd.getSoldierAt(Position(i % 24, (i / 24) % 24)) != nullptr;
+		i++;
+	});
+
+	bench("WorldData::getSoldierPositions", 1000000, [&]() {
+		gSink += wd.getSoldierPositions().test(i++ % (24 * 24));
+	});
+
+	const unsigned int n = MAX_NUM_TEAMS * MAX_TEAM_SOLDIERS;
+	bench("WorldData::inLineOfFire", 1000000, [&]() {
+		gSink += wd.inLineOfFire(SoldierID(i % n + 1), SoldierID((i / n) % n + 1));
+		i++;
+	});
+
+	// a soldier stepping back and forth, which updates the line matrices
+	Position from = wd.getSoldier(SoldierID(1))->position;
+	Position to = from;
+	for(int dy = -1; dy <= 1 && to == from; dy++) {
+		for(int dx = -1; dx <= 1; dx++) {
+			Position p(from.x + dx, from.y + dy);
+			if(p != from && wd.getMapData()->inside(p) &&
+					!wd.getMapData()->positionBlocked(p) && !wd.getSoldierAt(p)) {
+				to = p;
+				break;
+			}
+		}
+	}
+	if(to != from) {
+		bench("WorldData MovementInput 24x24", 100000, [&]() {
+			wd(MovementInput(SoldierID(1), from, to));
+			std::swap(from, to);
+			wd.getSoldier(SoldierID(1))->aps.value = MAX_APS;
+		});
+	}
+}
+
+static void benchVision()
+{
+	const unsigned int sizes[] = { 24, 256 };
+	for(auto size : sizes) {
+		MapData m = makeMap(size, size, 0.2f, 11);
+		FieldOfView fov;
+		unsigned int i = 0;
+		char name[64];
+		snprintf(name, sizeof(name), "FieldOfView::compute %ux%u r%u", size, size, SIGHT_RADIUS);
+		bench(name, 20000, [&]() {
+			Position p(i % size, (i * 7) % size);
+			fov.compute(m, p, SIGHT_RADIUS);
+			gSink += fov.visible(p);
+			i++;
+		});
+	}
+
+	// a soldier walking back and forth
+	WorldData wd(24, 24, MAX_TEAM_SOLDIERS, 11);
+	Game::Vision vision;
+	std::vector<SightingEvent> events;
+	vision.reset(wd, events);
+	bench("Vision::update 24x24", 20000, [&]() {
+		events.clear();
+		vision.update(wd, SoldierID(1), events);
+		gSink += events.size();
+	});
+}
+
+static void benchMapGenerate()
+{
+	const unsigned int sizes[] = { 24, 256 };
+	for(auto size : sizes) {
+		char name[64];
+		snprintf(name, sizeof(name), "MapData::generate %ux%u", size, size);
+		bench(name, size >= 256 ? 20 : 2000, [&]() {
+			MapData m;
+			Rng rng(5, RngStream::Map);
+			m.generate(size, size, rng);
+			gSink += m.getWidth();
+		});
+	}
+}
+
+static void benchSync()
+{
+	Game::World w(6);
+	WorldData wd;
+	bench("WorldData::sync", 10000, [&]() {
+		if(!wd.sync(w))
+			throw std::runtime_error("sync failed");
+	});
+}
+
+static void benchCheckpoint()
+{
+	const unsigned int sizes[] = { 24, 256 };
+	for(auto size : sizes) {
+		WorldData wd(size, size, MAX_TEAM_SOLDIERS, 8);
+		std::stringstream ss;
+		saveCheckpoint(ss, wd);
+		const std::string saved = ss.str();
+
+		char name[64];
+		snprintf(name, sizeof(name), "saveCheckpoint %ux%u (%zu bytes)",
+				size, size, saved.size());
+		bench(name, size >= 256 ? 50 : 2000, [&]() {
+			std::stringstream out;
+			saveCheckpoint(out, wd);
+			gSink += out.tellp();
+		});
+
+		snprintf(name, sizeof(name), "loadCheckpoint %ux%u", size, size);
+		bench(name, size >= 256 ? 50 : 2000, [&]() {
+			std::istringstream in(saved);
+			WorldData d;
+			loadCheckpoint(in, d);
+			gSink += d.getCurrentTeamID().id;
+		});
+	}
+
+	// the part of an autosave that runs on the game thread
+	WorldData wd(24, 24, MAX_TEAM_SOLDIERS, 8);
+	bench("WorldState copy for autosave 24x24", 100000, [&]() {
+		std::unique_ptr<WorldState> copy(new WorldState(wd.getState()));
+		gSink += copy->currentteam.id;
+	});
+}
+
+static void benchMapCodec()
+{
+	const unsigned int sizes[] = { 24, 256 };
+	for(auto size : sizes) {
+		for(int flat = 0; flat < 2; flat++) {
+			MapData m;
+			Rng rng(size, RngStream::Map);
+			m.generate(size, size, rng);
+			if(flat) {
+				// open floor inside a wall
+				for(unsigned int j = 0; j < size; j++) {
+					for(unsigned int i = 0; i < size; i++) {
+						MapFragment f;
+						f.grasslevel = GrassLevel::Floor;
+						f.wall = i == 0 || j == 0 || i == size - 1 || j == size - 1;
+						m.setPoint(i, j, f);
+					}
+				}
+			}
+			std::vector<unsigned char> buf;
+			encodeMap(m, buf);
+
+			char name[64];
+			snprintf(name, sizeof(name), "encodeMap %ux%u %s (%zu bytes)",
+					size, size, flat ? "flat" : "random", buf.size());
+			std::vector<unsigned char> out;
+			bench(name, size >= 256 ? 200 : 20000, [&]() {
+				out.clear();
+				encodeMap(m, out);
+				gSink += out.size();
+			});
+
+			snprintf(name, sizeof(name), "decodeMap %ux%u %s", size, size,
+					flat ? "flat" : "random");
+			bench(name, size >= 256 ? 200 : 20000, [&]() {
+				MapData d;
+				gSink += decodeMap(buf.data(), buf.size(), d);
+			});
+		}
+	}
+}
+
+static void benchMapFile()
+{
+	const unsigned int size = 4096;
+	const char* path = "panicfire-bench.map";
+	{
+		MapData m;
+		Rng rng(9, RngStream::Map);
+		m.generate(size, size, rng);
+		saveMapFile(path, m);
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "World from generated map %ux%u", size, size);
+	bench(name, 3, [&]() {
+		MapData m;
+		Rng rng(9, RngStream::Map);
+		m.generate(size, size, rng);
+		Game::World w(m, 9);
+		gSink += w.getData().getCurrentTeamID().id;
+	});
+
+	snprintf(name, sizeof(name), "World from map file %ux%u", size, size);
+	bench(name, 100, [&]() {
+		Game::World w(loadMapFile(path), 9);
+		gSink += w.getData().getCurrentTeamID().id;
+	});
+
+	remove(path);
+}
+
+static void benchChunkedMap()
+{
+	bench("ChunkedMap create 65536x65536", 10000, [&]() {
+		ChunkedMap cm(65536, 65536, 10);
+		gSink += cm.getWidth();
+	});
+
+	// an area that stays cached
+	ChunkedMap cm(65536, 65536, 10);
+	unsigned int i = 0;
+	bench("ChunkedMap::getPoint 256x256 area", 1000000, [&]() {
+		auto f = cm.getPoint(i % 256, (i / 256) % 256);
+		gSink += static_cast<unsigned int>(f.grasslevel);
+		i++;
+	});
+
+	// random tiles on a map with far more chunks than are cached
+	Rng rng(10, RngStream::Map);
+	bench("ChunkedMap::getPoint random 65536x65536", 2000, [&]() {
+		auto f = cm.getPoint(rng.uniform(0, 65536), rng.uniform(0, 65536));
+		gSink += static_cast<unsigned int>(f.grasslevel);
+	});
+	if(cm.getNumGeneratedChunks()) {
+		printf("  %u chunks cached, %llu generated\n",
+				cm.getNumLoadedChunks(), cm.getNumGeneratedChunks());
+	}
+
+	bench("ChunkedMap::getRegion 256x256", 200, [&]() {
+		gSink += cm.getRegion(0, 0, 256, 256).getWidth();
+	});
+}
+
+static void benchPollEvents()
+{
+	Game::World w(7);
+	const unsigned int numEvents = 64;
+	bench("World::pollEvents drain 64 events x 2 teams", 2000,
+			[&]() {
+				for(unsigned int i = 0; i < numEvents; i++)
+					w.input(FinishTurnInput());
+			},
+			[&]() {
+				for(unsigned int t = 1; t <= MAX_NUM_TEAMS; t++) {
+					while(1) {
+						auto ev = w.pollEvents(TeamID(t));
+						if(boost::get<EmptyEvent>(&ev))
+							break;
+					}
+				}
+			});
+}
+
+static void benchPollEventsBatched()
+{
+	Game::World w(7);
+	const unsigned int numEvents = 64;
+	std::vector<Event> events;
+	bench("World::pollEvents batched 64 events x 2 teams", 2000,
+			[&]() {
+				for(unsigned int i = 0; i < numEvents; i++)
+					w.input(FinishTurnInput());
+			},
+			[&]() {
+				for(unsigned int t = 1; t <= MAX_NUM_TEAMS; t++) {
+					events.clear();
+					gSink += w.pollEvents(TeamID(t), events);
+				}
+			});
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1)
+		gFilter = argv[1];
+
+	try {
+		benchAStar();
+		benchLine();
+		benchWorldData();
+		benchVision();
+		benchMapGenerate();
+		benchSync();
+		benchCheckpoint();
+		benchMapCodec();
+		benchMapFile();
+		benchChunkedMap();
+		benchPollEvents();
+		benchPollEventsBatched();
+	}
+	catch (std::exception& e) {
+		std::cerr << "std::exception: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
+
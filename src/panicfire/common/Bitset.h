@@ -0,0 +1,131 @@
+#ifndef PANICFIRE_COMMON_BITSET_H
+#define PANICFIRE_COMMON_BITSET_H
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace PanicFire {
+
+namespace Common {
+
+// Read-only bits stored like a Bitset's words, wherever they live,
+// e.g. in a memory-mapped file.
+class BitsetView {
+	public:
+		BitsetView(const uint64_t* words = nullptr, unsigned int n = 0);
+		unsigned int size() const;
+		bool test(unsigned int i) const;
+		// (size() + 63) / 64 words, unused bits zero
+		const uint64_t* data() const;
+
+	private:
+		const uint64_t* mWords;
+		unsigned int mSize;
+};
+
+// Runtime sized bitset, typically holding one bit per map tile
+// indexed by y * width + x.
+class Bitset {
+	public:
+		Bitset(unsigned int n = 0);
+		explicit Bitset(const BitsetView& v);
+		void resize(unsigned int n);
+		void clear();
+		unsigned int size() const;
+		bool test(unsigned int i) const;
+		void set(unsigned int i);
+		void reset(unsigned int i);
+		void assign(unsigned int i, bool v);
+		BitsetView view() const;
+
+	private:
+		unsigned int mSize;
+		std::vector<uint64_t> mWords;
+};
+
+inline BitsetView::BitsetView(const uint64_t* words, unsigned int n)
+	: mWords(words),
+	mSize(n)
+{
+}
+
+inline unsigned int BitsetView::size() const
+{
+	return mSize;
+}
+
+inline bool BitsetView::test(unsigned int i) const
+{
+	return (mWords[i >> 6] >> (i & 63)) & 1;
+}
+
+inline const uint64_t* BitsetView::data() const
+{
+	return mWords;
+}
+
+inline Bitset::Bitset(unsigned int n)
+	: mSize(0)
+{
+	resize(n);
+}
+
+inline Bitset::Bitset(const BitsetView& v)
+	: mSize(v.size()),
+	mWords(v.data(), v.data() + (v.size() + 63) / 64)
+{
+}
+
+inline void Bitset::resize(unsigned int n)
+{
+	mSize = n;
+	mWords.resize((n + 63) / 64);
+	clear();
+}
+
+inline void Bitset::clear()
+{
+	for(auto& w : mWords)
+		w = 0;
+}
+
+inline unsigned int Bitset::size() const
+{
+	return mSize;
+}
+
+inline bool Bitset::test(unsigned int i) const
+{
+	return (mWords[i >> 6] >> (i & 63)) & 1;
+}
+
+inline void Bitset::set(unsigned int i)
+{
+	mWords[i >> 6] |= uint64_t(1) << (i & 63);
+}
+
+inline void Bitset::reset(unsigned int i)
+{
+	mWords[i >> 6] &= ~(uint64_t(1) << (i & 63));
+}
+
+inline void Bitset::assign(unsigned int i, bool v)
+{
+	if(v)
+		set(i);
+	else
+		reset(i);
+}
+
+inline BitsetView Bitset::view() const
+{
+	return BitsetView(mWords.data(), mSize);
+}
+
+}
+
+}
+
+#endif
+
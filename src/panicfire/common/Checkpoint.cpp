@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/archive_exception.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include "panicfire/common/Serialization.h"
+#include "panicfire/common/Checkpoint.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+static const uint32_t CheckpointMagic = 0x53434650; // "PFCS"
+static const uint32_t CheckpointVersion = 2;
+
+static const boost::archive::archive_flags ArchiveFlags =
+	boost::archive::archive_flags(boost::archive::no_header | boost::archive::no_codecvt);
+
+void saveCheckpoint(std::ostream& out, const WorldData& d)
+{
+	saveCheckpoint(out, d.getState());
+}
+
+void saveCheckpoint(std::ostream& out, const WorldState& s)
+{
+	{
+		boost::archive::binary_oarchive ar(out, ArchiveFlags);
+		ar << CheckpointMagic;
+		ar << CheckpointVersion;
+	}
+
+	{
+		boost::iostreams::filtering_ostream zout;
+		zout.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
+		zout.push(out);
+		boost::archive::binary_oarchive ar(zout, ArchiveFlags);
+		ar << s;
+	}
+
+	if(!out)
+		throw std::runtime_error("Checkpoint: write failed");
+}
+
+void loadCheckpoint(std::istream& in, WorldData& d)
+{
+	try {
+		{
+			uint32_t magic, version;
+			boost::archive::binary_iarchive ar(in, ArchiveFlags);
+			ar >> magic;
+			ar >> version;
+			if(magic != CheckpointMagic)
+				throw std::runtime_error("Checkpoint: not a checkpoint");
+			if(version != CheckpointVersion)
+				throw std::runtime_error("Checkpoint: unsupported version");
+		}
+
+		boost::iostreams::filtering_istream zin;
+		zin.push(boost::iostreams::zlib_decompressor());
+		zin.push(in);
+		boost::archive::binary_iarchive ar(zin, ArchiveFlags);
+		ar >> d;
+	}
+	catch(boost::archive::archive_exception& e) {
+		throw std::runtime_error(std::string("Checkpoint: corrupt data: ") + e.what());
+	}
+	catch(boost::iostreams::zlib_error& e) {
+		throw std::runtime_error(std::string("Checkpoint: corrupt data: ") + e.what());
+	}
+}
+
+void saveCheckpoint(const std::string& path, const WorldData& d)
+{
+	saveCheckpoint(path, d.getState());
+}
+
+void saveCheckpoint(const std::string& path, const WorldState& s)
+{
+	std::string tmppath = path + ".tmp";
+	{
+		std::ofstream out(tmppath.c_str(), std::ios::binary | std::ios::trunc);
+		if(!out)
+			throw std::runtime_error("Checkpoint: could not open " + tmppath);
+		saveCheckpoint(out, s);
+		out.close();
+		if(!out)
+			throw std::runtime_error("Checkpoint: could not write " + tmppath);
+	}
+	if(rename(tmppath.c_str(), path.c_str()))
+		throw std::runtime_error("Checkpoint: could not rename " + tmppath + " to " + path);
+}
+
+void loadCheckpoint(const std::string& path, WorldData& d)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if(!in)
+		throw std::runtime_error("Checkpoint: could not open " + path);
+	loadCheckpoint(in, d);
+}
+
+}
+
+}
+
@@ -0,0 +1,33 @@
+#ifndef PANICFIRE_COMMON_CHECKPOINT_H
+#define PANICFIRE_COMMON_CHECKPOINT_H
+
+#include <iostream>
+#include <string>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+// Checkpoints hold the complete WorldData (map, teams, soldiers and
+// whose turn it is): a small uncompressed header with a magic and a
+// format version, followed by the zlib compressed state.
+// All functions throw std::runtime_error on failure.
+// A checkpoint saved from a WorldState loads as the WorldData it came from.
+void saveCheckpoint(std::ostream& out, const WorldData& d);
+void saveCheckpoint(std::ostream& out, const WorldState& s);
+void loadCheckpoint(std::istream& in, WorldData& d);
+
+// writes to a temporary file first, so an existing checkpoint is
+// replaced only once the new one is complete
+void saveCheckpoint(const std::string& path, const WorldData& d);
+void saveCheckpoint(const std::string& path, const WorldState& s);
+void loadCheckpoint(const std::string& path, WorldData& d);
+
+}
+
+}
+
+#endif
+
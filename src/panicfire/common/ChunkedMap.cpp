@@ -0,0 +1,156 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "panicfire/common/ChunkedMap.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+const unsigned int ChunkedMap::ChunkSize;
+
+ChunkedMap::ChunkedMap(unsigned int w, unsigned int h, uint64_t seed,
+		unsigned int maxchunks)
+	: mWidth(w),
+	mHeight(h),
+	mChunksX((w + ChunkSize - 1) / ChunkSize),
+	mSeed(seed),
+	mMaxChunks(maxchunks),
+	mLastIndex(0),
+	mLast(nullptr),
+	mGenerated(0)
+{
+	// chunk indices double as Rng substreams
+	uint64_t chunksy = (h + ChunkSize - 1) / ChunkSize;
+	if(uint64_t(mChunksX) * chunksy > 0xffffffffu)
+		throw std::runtime_error("ChunkedMap: map too large");
+}
+
+ChunkedMap::Chunk& ChunkedMap::chunkAt(unsigned int x, unsigned int y) const
+{
+	if(x >= mWidth || y >= mHeight)
+		throw std::runtime_error("ChunkedMap: access outside boundary");
+	unsigned int index = (y / ChunkSize) * mChunksX + x / ChunkSize;
+	if(mLast && mLastIndex == index)
+		return *mLast;
+
+	Chunk* c;
+	auto it = mChunks.find(index);
+	if(it == mChunks.end()) {
+		c = &loadChunk(index);
+	} else {
+		c = &it->second;
+		if(!c->modified)
+			mLRU.splice(mLRU.begin(), mLRU, c->lru);
+	}
+	mLastIndex = index;
+	mLast = c;
+	return *c;
+}
+
+ChunkedMap::Chunk& ChunkedMap::loadChunk(unsigned int index) const
+{
+	while(!mLRU.empty() && mLRU.size() >= mMaxChunks) {
+		unsigned int old = mLRU.back();
+		mLRU.pop_back();
+		mChunks.erase(old);
+		if(mLastIndex == old)
+			mLast = nullptr;
+	}
+
+	unsigned int cx = index % mChunksX * ChunkSize;
+	unsigned int cy = index / mChunksX * ChunkSize;
+	Chunk& c = mChunks[index];
+	Rng rng(mSeed, RngStream::Map, index);
+	c.tiles.generate(std::min(ChunkSize, mWidth - cx), std::min(ChunkSize, mHeight - cy), rng);
+	c.modified = false;
+	mLRU.push_front(index);
+	c.lru = mLRU.begin();
+	mGenerated++;
+	return c;
+}
+
+MapFragment ChunkedMap::getPoint(unsigned int x, unsigned int y) const
+{
+	return chunkAt(x, y).tiles.getPoint(x % ChunkSize, y % ChunkSize);
+}
+
+void ChunkedMap::setPoint(unsigned int x, unsigned int y, const MapFragment& f)
+{
+	Chunk& c = chunkAt(x, y);
+	if(!c.modified) {
+		mLRU.erase(c.lru);
+		c.modified = true;
+	}
+	c.tiles.setPoint(x % ChunkSize, y % ChunkSize, f);
+}
+
+unsigned int ChunkedMap::getWidth() const
+{
+	return mWidth;
+}
+
+unsigned int ChunkedMap::getHeight() const
+{
+	return mHeight;
+}
+
+unsigned int ChunkedMap::movementCost(const Position& p) const
+{
+	return chunkAt(p.x, p.y).tiles.movementCost(Position(p.x % ChunkSize, p.y % ChunkSize));
+}
+
+bool ChunkedMap::positionBlocked(const Position& p) const
+{
+	return chunkAt(p.x, p.y).tiles.positionBlocked(Position(p.x % ChunkSize, p.y % ChunkSize));
+}
+
+bool ChunkedMap::inside(const Position& p) const
+{
+	return p.x < mWidth && p.y < mHeight;
+}
+
+MapData ChunkedMap::getRegion(unsigned int x, unsigned int y, unsigned int w, unsigned int h) const
+{
+	if(x > mWidth || y > mHeight || w > mWidth - x || h > mHeight - y)
+		throw std::runtime_error("ChunkedMap: region outside boundary");
+
+	// copied a chunk at a time so that each chunk is only looked up
+	// once, however few of them the cache holds
+	std::vector<unsigned char> terrain(size_t(w) * h);
+	for(unsigned int cy = y - y % ChunkSize; cy < y + h; cy += ChunkSize) {
+		for(unsigned int cx = x - x % ChunkSize; cx < x + w; cx += ChunkSize) {
+			const MapData& tiles = chunkAt(cx, cy).tiles;
+			unsigned int cw = tiles.getWidth();
+			unsigned int i0 = std::max(x, cx);
+			unsigned int i1 = std::min(x + w, cx + cw);
+			unsigned int j1 = std::min(y + h, cy + tiles.getHeight());
+			for(unsigned int j = std::max(y, cy); j < j1; j++) {
+				memcpy(&terrain[size_t(j - y) * w + (i0 - x)],
+						tiles.getTerrainGrid() + (j - cy) * cw + (i0 - cx), i1 - i0);
+			}
+		}
+	}
+
+	MapData m;
+	m.assign(w, h, terrain.data());
+	return m;
+}
+
+unsigned int ChunkedMap::getNumLoadedChunks() const
+{
+	return mChunks.size();
+}
+
+unsigned long long ChunkedMap::getNumGeneratedChunks() const
+{
+	return mGenerated;
+}
+
+}
+
+}
+
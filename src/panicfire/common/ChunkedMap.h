@@ -0,0 +1,80 @@
+#ifndef PANICFIRE_COMMON_CHUNKEDMAP_H
+#define PANICFIRE_COMMON_CHUNKEDMAP_H
+
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+// Map of any size stored as ChunkSize x ChunkSize tile chunks, each
+// generated on first access from the seed and the chunk's coordinates
+// alone, so a chunk looks the same no matter which other chunks have
+// been visited. Creating the map is O(1) and memory grows with the
+// area touched.
+//
+// Up to maxchunks unmodified chunks are cached; the least recently
+// used one is dropped when another one is needed and regenerated if
+// it's visited again. Chunks written to with setPoint are kept.
+//
+// getPoint etc. behave like MapData's. They update the cache, so a
+// ChunkedMap must not be used by several threads at once, even
+// through const references.
+class ChunkedMap {
+	public:
+		static const unsigned int ChunkSize = 64;
+
+		ChunkedMap(unsigned int w, unsigned int h, uint64_t seed,
+				unsigned int maxchunks = 1024);
+		ChunkedMap(const ChunkedMap&) = delete;
+		ChunkedMap& operator=(const ChunkedMap&) = delete;
+
+		MapFragment getPoint(unsigned int x, unsigned int y) const;
+		void setPoint(unsigned int x, unsigned int y, const MapFragment& f);
+		unsigned int getWidth() const;
+		unsigned int getHeight() const;
+		unsigned int movementCost(const Position& p) const;
+		bool positionBlocked(const Position& p) const;
+		bool inside(const Position& p) const;
+
+		// copies the given area to a flat map, e.g. for a World
+		MapData getRegion(unsigned int x, unsigned int y, unsigned int w, unsigned int h) const;
+
+		unsigned int getNumLoadedChunks() const;
+		unsigned long long getNumGeneratedChunks() const;
+
+	private:
+		struct Chunk {
+			MapData tiles;
+			bool modified;
+			std::list<unsigned int>::iterator lru;
+		};
+
+		Chunk& chunkAt(unsigned int x, unsigned int y) const;
+		Chunk& loadChunk(unsigned int index) const;
+
+		unsigned int mWidth;
+		unsigned int mHeight;
+		unsigned int mChunksX;
+		uint64_t mSeed;
+		unsigned int mMaxChunks;
+
+		mutable std::unordered_map<unsigned int, Chunk> mChunks;
+		// unmodified chunks, most recently used first
+		mutable std::list<unsigned int> mLRU;
+		mutable unsigned int mLastIndex;
+		mutable Chunk* mLast;
+		mutable unsigned long long mGenerated;
+};
+
+}
+
+}
+
+#endif
+
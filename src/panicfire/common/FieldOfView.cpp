@@ -0,0 +1,119 @@
+#include <math.h>
+
+#include <algorithm>
+
+#include "panicfire/common/FieldOfView.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+FieldOfView::FieldOfView()
+	: mMapWidth(0),
+	mMapHeight(0),
+	mOriginX(0),
+	mOriginY(0),
+	mRadius(0),
+	mX0(0),
+	mY0(0),
+	mWidth(0),
+	mHeight(0)
+{
+}
+
+void FieldOfView::clear()
+{
+	mX0 = mY0 = 0;
+	mWidth = mHeight = 0;
+	mBits.resize(0);
+}
+
+void FieldOfView::compute(const MapData& m, const Position& origin, unsigned int radius)
+{
+	mBlocked = m.getBlockedGrid();
+	mMapWidth = m.getWidth();
+	mMapHeight = m.getHeight();
+	mOriginX = origin.x;
+	mOriginY = origin.y;
+	mRadius = radius;
+	mX0 = origin.x > radius ? origin.x - radius : 0;
+	mY0 = origin.y > radius ? origin.y - radius : 0;
+	mWidth = std::min(m.getWidth(), origin.x + radius + 1) - mX0;
+	mHeight = std::min(m.getHeight(), origin.y + radius + 1) - mY0;
+	// keeps the capacity, so recomputing doesn't allocate
+	mBits.resize(mWidth * mHeight);
+
+	mark(mOriginX, mOriginY);
+	// transforms from the first octant to each of the eight
+	static const int mult[4][8] = {
+		{ 1,  0,  0, -1, -1,  0,  0,  1 },
+		{ 0,  1, -1,  0,  0, -1,  1,  0 },
+		{ 0,  1,  1,  0,  0, -1, -1,  0 },
+		{ 1,  0,  0,  1, -1,  0,  0, -1 }
+	};
+	for(int oct = 0; oct < 8; oct++) {
+		castLight(1, 1.0f, 0.0f, mult[0][oct], mult[1][oct],
+				mult[2][oct], mult[3][oct]);
+	}
+}
+
+void FieldOfView::mark(int x, int y)
+{
+	unsigned int wx = x - mX0;
+	unsigned int wy = y - mY0;
+	if(wx < mWidth && wy < mHeight)
+		mBits.set(wy * mWidth + wx);
+}
+
+// scans the octant row by row between the slopes start and end,
+// narrowing the scan and recursing around blocked tiles
+void FieldOfView::castLight(int row, float start, float end,
+		int xx, int xy, int yx, int yy)
+{
+	if(start < end)
+		return;
+
+	int r2 = mRadius * mRadius;
+	float newstart = 0.0f;
+	for(int j = row; j <= mRadius; j++) {
+		int dy = -j;
+		bool blocked = false;
+		// skip the tiles before the start slope without testing them
+		int first = std::max(-j, int(floorf(-start * (j + 0.5f) - 0.5f)));
+		for(int dx = first; dx <= 0; dx++) {
+			int x = mOriginX + dx * xx + dy * xy;
+			int y = mOriginY + dx * yx + dy * yy;
+			float lslope = (dx - 0.5f) / (dy + 0.5f);
+			float rslope = (dx + 0.5f) / (dy - 0.5f);
+			if(start < rslope)
+				continue;
+			if(end > lslope)
+				break;
+
+			bool inside = x >= 0 && y >= 0 && x < mMapWidth && y < mMapHeight;
+			if(inside && dx * dx + dy * dy <= r2)
+				mark(x, y);
+			// everything outside the map blocks sight
+			bool opaque = !inside || mBlocked.test(y * mMapWidth + x);
+			if(blocked) {
+				if(opaque) {
+					newstart = rslope;
+				} else {
+					blocked = false;
+					start = newstart;
+				}
+			} else if(opaque && j < mRadius) {
+				blocked = true;
+				castLight(j + 1, start, lslope, xx, xy, yx, yy);
+				newstart = rslope;
+			}
+		}
+		if(blocked)
+			break;
+	}
+}
+
+}
+
+}
+
@@ -0,0 +1,81 @@
+#ifndef PANICFIRE_COMMON_FIELDOFVIEW_H
+#define PANICFIRE_COMMON_FIELDOFVIEW_H
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+// The tiles seen from a position within a radius, found by recursive
+// shadowcasting over the map's blocked layer. Blocked tiles are seen
+// themselves but hide what's behind them. The result is kept in a
+// window of at most (2 * radius + 1)^2 bits around the origin, so the
+// cost doesn't depend on the map size.
+class FieldOfView {
+	public:
+		FieldOfView();
+		void compute(const MapData& m, const Position& origin, unsigned int radius);
+		// nothing is visible afterwards
+		void clear();
+		bool visible(const Position& p) const;
+
+		// the window in map coordinates, x0 <= x < x1 and y0 <= y < y1;
+		// empty if nothing is visible
+		unsigned int getX0() const;
+		unsigned int getY0() const;
+		unsigned int getX1() const;
+		unsigned int getY1() const;
+
+	private:
+		void castLight(int row, float start, float end,
+				int xx, int xy, int yx, int yy);
+		void mark(int x, int y);
+
+		// the map being scanned, during compute()
+		BitsetView mBlocked;
+		int mMapWidth;
+		int mMapHeight;
+		int mOriginX;
+		int mOriginY;
+		int mRadius;
+		unsigned int mX0;
+		unsigned int mY0;
+		unsigned int mWidth;
+		unsigned int mHeight;
+		Bitset mBits;
+};
+
+inline bool FieldOfView::visible(const Position& p) const
+{
+	unsigned int x = p.x - mX0;
+	unsigned int y = p.y - mY0;
+	return x < mWidth && y < mHeight && mBits.test(y * mWidth + x);
+}
+
+inline unsigned int FieldOfView::getX0() const
+{
+	return mX0;
+}
+
+inline unsigned int FieldOfView::getY0() const
+{
+	return mY0;
+}
+
+inline unsigned int FieldOfView::getX1() const
+{
+	return mX0 + mWidth;
+}
+
+inline unsigned int FieldOfView::getY1() const
+{
+	return mY0 + mHeight;
+}
+
+}
+
+}
+
+#endif
+
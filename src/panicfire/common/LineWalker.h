@@ -0,0 +1,72 @@
+#ifndef PANICFIRE_COMMON_LINEWALKER_H
+#define PANICFIRE_COMMON_LINEWALKER_H
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+// Steps through the tiles on the line between two positions, from
+// included to to included, using Bresenham's algorithm. Keeps only a
+// few integers of state, so callers can stop at the first tile that
+// interests them without building the whole line.
+class LineWalker {
+	public:
+		LineWalker(const Position& from, const Position& to);
+		const Position& position() const;
+		// true once position() is to
+		bool atEnd() const;
+		// must not be called at the end
+		void next();
+
+	private:
+		Position mPos;
+		Position mTo;
+		int mDx;
+		int mDy;
+		int mSx;
+		int mSy;
+		int mErr;
+};
+
+inline LineWalker::LineWalker(const Position& from, const Position& to)
+	: mPos(from),
+	mTo(to),
+	mDx(from.x < to.x ? to.x - from.x : from.x - to.x),
+	mDy(from.y < to.y ? from.y - to.y : to.y - from.y),
+	mSx(from.x < to.x ? 1 : -1),
+	mSy(from.y < to.y ? 1 : -1),
+	mErr(mDx + mDy)
+{
+}
+
+inline const Position& LineWalker::position() const
+{
+	return mPos;
+}
+
+inline bool LineWalker::atEnd() const
+{
+	return mPos == mTo;
+}
+
+inline void LineWalker::next()
+{
+	int e2 = 2 * mErr;
+	if(e2 >= mDy) {
+		mErr += mDy;
+		mPos.x += mSx;
+	}
+	if(e2 <= mDx) {
+		mErr += mDx;
+		mPos.y += mSy;
+	}
+}
+
+}
+
+}
+
+#endif
+
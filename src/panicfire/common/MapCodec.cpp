@@ -0,0 +1,225 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "panicfire/common/MapCodec.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+namespace {
+
+class BitWriter {
+	public:
+		BitWriter(std::vector<unsigned char>& out)
+			: mOut(out), mAcc(0), mBits(0) { }
+
+		// n <= 32
+		void put(uint32_t v, unsigned int n)
+		{
+			mAcc |= uint64_t(v) << mBits;
+			mBits += n;
+			if(mBits >= 32) {
+				for(int i = 0; i < 4; i++) {
+					mOut.push_back(mAcc & 0xff);
+					mAcc >>= 8;
+				}
+				mBits -= 32;
+			}
+		}
+
+		// x >= 1
+		void putGamma(uint32_t x)
+		{
+			unsigned int k = 31 - __builtin_clz(x);
+			put(0, k);
+			put(1, 1);
+			put(x & ((uint64_t(1) << k) - 1), k);
+		}
+
+		void flush()
+		{
+			while(mBits > 0) {
+				mOut.push_back(mAcc & 0xff);
+				mAcc >>= 8;
+				mBits = mBits > 8 ? mBits - 8 : 0;
+			}
+		}
+
+	private:
+		std::vector<unsigned char>& mOut;
+		uint64_t mAcc;
+		unsigned int mBits;
+};
+
+class BitReader {
+	public:
+		BitReader(const unsigned char* p, const unsigned char* end)
+			: mStart(p), mPos(p), mEnd(end), mAcc(0), mBits(0) { }
+
+		// n <= 32
+		uint32_t get(unsigned int n)
+		{
+			if(mBits < n) {
+				refill();
+				if(mBits < n)
+					throw std::runtime_error("MapCodec: truncated map");
+			}
+			uint32_t v = mAcc & ((uint64_t(1) << n) - 1);
+			mAcc >>= n;
+			mBits -= n;
+			return v;
+		}
+
+		uint32_t getGamma()
+		{
+			unsigned int k = 0;
+			while(get(1) == 0) {
+				if(++k > 31)
+					throw std::runtime_error("MapCodec: invalid run length");
+			}
+			return (uint32_t(1) << k) | get(k);
+		}
+
+		// whole bytes read, counting a partly read last byte
+		size_t consumed() const
+		{
+			return (mPos - mStart) - mBits / 8;
+		}
+
+	private:
+		void refill()
+		{
+			while(mBits <= 56 && mPos < mEnd) {
+				mAcc |= uint64_t(*mPos++) << mBits;
+				mBits += 8;
+			}
+		}
+
+		const unsigned char* mStart;
+		const unsigned char* mPos;
+		const unsigned char* mEnd;
+		uint64_t mAcc;
+		unsigned int mBits;
+};
+
+unsigned int indexBits(unsigned int palettesize)
+{
+	return palettesize <= 1 ? 0 : 32 - __builtin_clz(palettesize - 1);
+}
+
+// an upper bound for the tiles that n bytes of tile codes can cover.
+// Every run takes at least one bit and covers fewer than 2^(k+1) tiles
+// with a 2k+1 bit gamma code, and there's at most one tile without a
+// run per bit, or per run plus one with a single palette entry.
+uint64_t maxTiles(size_t n)
+{
+	uint64_t bits = uint64_t(n) * 8;
+	if(bits == 0)
+		return 1;
+	uint64_t k = std::min<uint64_t>(31, (bits - 1) / 2);
+	return 1 + bits * ((uint64_t(1) << (k + 1)) + 1);
+}
+
+}
+
+void encodeMap(const MapData& m, std::vector<unsigned char>& out)
+{
+	unsigned int w = m.getWidth();
+	unsigned int h = m.getHeight();
+	if(w > 0xffff || h > 0xffff)
+		throw std::runtime_error("MapCodec: map too large");
+	size_t count = size_t(w) * h;
+	const unsigned char* t = m.getTerrainGrid();
+
+	std::array<int, 256> index;
+	index.fill(-1);
+	std::vector<unsigned char> palette;
+	for(size_t i = 0; i < count; i++) {
+		if(index[t[i]] < 0) {
+			index[t[i]] = palette.size();
+			palette.push_back(t[i]);
+		}
+	}
+	// terrain bytes only use seven bits
+	if(palette.size() > 255)
+		throw std::runtime_error("MapCodec: invalid terrain");
+
+	out.push_back(w & 0xff);
+	out.push_back(w >> 8);
+	out.push_back(h & 0xff);
+	out.push_back(h >> 8);
+	out.push_back(palette.size());
+	out.insert(out.end(), palette.begin(), palette.end());
+
+	BitWriter bw(out);
+	unsigned int bits = indexBits(palette.size());
+	int prev = -1;
+	for(size_t i = 0; i < count; ) {
+		int s = index[t[i]];
+		bw.put(s, bits);
+		i++;
+		if(s == prev) {
+			size_t r = 0;
+			while(i + r < count && t[i + r] == t[i - 1])
+				r++;
+			bw.putGamma(r + 1);
+			i += r;
+			prev = -1;
+		} else {
+			prev = s;
+		}
+	}
+	bw.flush();
+}
+
+size_t decodeMap(const unsigned char* p, size_t n, MapData& m)
+{
+	if(n < 5)
+		throw std::runtime_error("MapCodec: truncated map");
+	unsigned int w = p[0] | (p[1] << 8);
+	unsigned int h = p[2] | (p[3] << 8);
+	unsigned int palettesize = p[4];
+	if(n - 5 < palettesize)
+		throw std::runtime_error("MapCodec: truncated map");
+	const unsigned char* palette = p + 5;
+	size_t count = size_t(w) * h;
+	if(count && !palettesize)
+		throw std::runtime_error("MapCodec: missing palette");
+	if(count > MaxDecodedTiles)
+		throw std::runtime_error("MapCodec: map too large");
+	if(count > maxTiles(n - 5 - palettesize))
+		throw std::runtime_error("MapCodec: truncated map");
+
+	std::vector<unsigned char> terrain(count);
+	BitReader br(palette + palettesize, p + n);
+	unsigned int bits = indexBits(palettesize);
+	int prev = -1;
+	for(size_t i = 0; i < count; ) {
+		uint32_t s = br.get(bits);
+		if(s >= palettesize)
+			throw std::runtime_error("MapCodec: invalid palette index");
+		terrain[i++] = palette[s];
+		if(int(s) == prev) {
+			uint32_t r = br.getGamma() - 1;
+			if(r > count - i)
+				throw std::runtime_error("MapCodec: invalid run length");
+			std::fill(terrain.begin() + i, terrain.begin() + i + r, palette[s]);
+			i += r;
+			prev = -1;
+		} else {
+			prev = s;
+		}
+	}
+
+	m.assign(w, h, terrain.data());
+	return 5 + palettesize + br.consumed();
+}
+
+}
+
+}
+
@@ -0,0 +1,43 @@
+#ifndef PANICFIRE_COMMON_MAPCODEC_H
+#define PANICFIRE_COMMON_MAPCODEC_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+// Compact encoding of a map for sockets and files. Only the packed
+// terrain is stored:
+//
+//   u16 width, u16 height, u8 palette size n, n palette terrain bytes
+//   bit stream, least significant bit first, of the tiles in row order
+//
+// Each tile is its palette index in ceil(log2(n)) bits. Whenever a tile
+// repeats the one before it, the number of further repeats plus one
+// follows as an Elias gamma code, so flat areas cost a few bits per run
+// while noisy terrain stays close to the bits per tile of the palette.
+
+// appends the encoded map to out
+void encodeMap(const MapData& m, std::vector<unsigned char>& out);
+
+// larger maps are rejected when decoding, before anything is allocated
+static const size_t MaxDecodedTiles = 4096 * 4096;
+// no valid encoding of such a map is longer: the header and palette,
+// then at most nine bits per tile (an index and a one bit run length)
+static const size_t MaxEncodedMapSize = 5 + 255 + (MaxDecodedTiles * 9 + 7) / 8;
+
+// returns the number of bytes read; throws std::runtime_error if the
+// data is truncated or malformed
+size_t decodeMap(const unsigned char* p, size_t n, MapData& m);
+
+}
+
+}
+
+#endif
+
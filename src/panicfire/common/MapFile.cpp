@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#include "panicfire/common/MapFile.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+static const uint32_t MapFileMagic = 0x504d4650; // "PFMP"
+static const uint32_t MapFileVersion = 1;
+
+namespace {
+
+struct Header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint64_t reserved;
+};
+
+static_assert(sizeof(Header) == 24, "map file header must be packed");
+
+struct Layout {
+	Layout(uint64_t w, uint64_t h)
+		: tiles(w * h),
+		terrain(sizeof(Header)),
+		cost(terrain + tiles),
+		blocked((cost + tiles + 7) & ~uint64_t(7)),
+		size(blocked + (tiles + 63) / 64 * 8)
+	{
+	}
+
+	uint64_t tiles;
+	uint64_t terrain;
+	uint64_t cost;
+	uint64_t blocked;
+	uint64_t size;
+};
+
+// the layers are stored as they are in memory
+bool littleEndian()
+{
+	uint16_t v = 1;
+	return *reinterpret_cast<const unsigned char*>(&v) == 1;
+}
+
+}
+
+void saveMapFile(const std::string& path, const MapData& m)
+{
+	if(!littleEndian())
+		throw std::runtime_error("MapFile: only supported on little endian hosts");
+
+	Header hdr;
+	hdr.magic = MapFileMagic;
+	hdr.version = MapFileVersion;
+	hdr.width = m.getWidth();
+	hdr.height = m.getHeight();
+	hdr.reserved = 0;
+	Layout layout(hdr.width, hdr.height);
+
+	std::string tmppath = path + ".tmp";
+	{
+		std::ofstream out(tmppath.c_str(), std::ios::binary | std::ios::trunc);
+		if(!out)
+			throw std::runtime_error("MapFile: could not open " + tmppath);
+		out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+		out.write(reinterpret_cast<const char*>(m.getTerrainGrid()), layout.tiles);
+		out.write(reinterpret_cast<const char*>(m.getCostGrid()), layout.tiles);
+		static const char padding[8] = { 0 };
+		out.write(padding, layout.blocked - (layout.cost + layout.tiles));
+		out.write(reinterpret_cast<const char*>(m.getBlockedGrid().data()),
+				layout.size - layout.blocked);
+		out.close();
+		if(!out)
+			throw std::runtime_error("MapFile: could not write " + tmppath);
+	}
+	if(rename(tmppath.c_str(), path.c_str()))
+		throw std::runtime_error("MapFile: could not rename " + tmppath + " to " + path);
+}
+
+MapData loadMapFile(const std::string& path)
+{
+	if(!littleEndian())
+		throw std::runtime_error("MapFile: only supported on little endian hosts");
+
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		throw std::runtime_error("MapFile: could not open " + path + ": " + strerror(errno));
+
+	struct stat st;
+	Header hdr;
+	if(fstat(fd, &st) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+		::close(fd);
+		throw std::runtime_error("MapFile: could not read " + path);
+	}
+	if(hdr.magic != MapFileMagic || hdr.version != MapFileVersion) {
+		::close(fd);
+		throw std::runtime_error("MapFile: " + path + " is not a map file");
+	}
+	Layout layout(hdr.width, hdr.height);
+	if(uint64_t(st.st_size) < layout.size || layout.tiles > 0xffffffffu) {
+		::close(fd);
+		throw std::runtime_error("MapFile: " + path + " is truncated");
+	}
+
+	void* p = mmap(nullptr, layout.size, PROT_READ, MAP_SHARED, fd, 0);
+	int err = errno;
+	::close(fd);
+	if(p == MAP_FAILED)
+		throw std::runtime_error("MapFile: could not map " + path + ": " + strerror(err));
+
+	size_t len = layout.size;
+	std::shared_ptr<const void> mapping(p, [len](const void* addr) {
+		munmap(const_cast<void*>(addr), len);
+	});
+	const unsigned char* base = static_cast<const unsigned char*>(p);
+
+	MapData m;
+	m.assignView(hdr.width, hdr.height, base + layout.terrain, base + layout.cost,
+			reinterpret_cast<const uint64_t*>(base + layout.blocked), mapping);
+	return m;
+}
+
+}
+
+}
+
@@ -0,0 +1,38 @@
+#ifndef PANICFIRE_COMMON_MAPFILE_H
+#define PANICFIRE_COMMON_MAPFILE_H
+
+#include <string>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Common {
+
+// Binary map files hold MapData's layers exactly as they are kept in
+// memory, so that a file is mapped and used in place: loading doesn't
+// decode or copy the layers and all worlds on the same map share the
+// page cache. Layout, little endian:
+//
+//   header    magic "PFMP", u32 version, u32 width, u32 height, u64 0
+//   terrain   width * height packed terrain bytes
+//   cost      width * height movement cost bytes
+//   blocked   the blocked bitset as u64 words, 8 byte aligned
+//
+// Loading checks the header and the file size, and reads the layers
+// once to check that the terrain is valid and the other layers match
+// it. All functions throw std::runtime_error on failure.
+
+// writes to a temporary file first, so an existing map file is replaced
+// only once the new one is complete
+void saveMapFile(const std::string& path, const MapData& m);
+
+// the returned map and its copies keep the file mapped
+MapData loadMapFile(const std::string& path);
+
+}
+
+}
+
+#endif
+
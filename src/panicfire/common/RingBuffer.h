@@ -0,0 +1,196 @@
+#ifndef PANICFIRE_COMMON_RINGBUFFER_H
+#define PANICFIRE_COMMON_RINGBUFFER_H
+
+#include <assert.h>
+
+#include <new>
+#include <memory>
+#include <type_traits>
+
+namespace PanicFire {
+
+namespace Common {
+
+// FIFO on a preallocated power of two sized array. Pushing and popping
+// don't allocate; the capacity only doubles when a push finds the
+// buffer full, so a reader that falls far behind never loses elements.
+// T doesn't need to be default constructible.
+template<typename T>
+class RingBuffer {
+	public:
+		RingBuffer(unsigned int capacity = 256);
+		RingBuffer(const RingBuffer& oth);
+		RingBuffer& operator=(const RingBuffer& oth);
+		~RingBuffer();
+
+		bool empty() const;
+		unsigned int size() const;
+		unsigned int capacity() const;
+		void push_back(const T& t);
+		T& front();
+		const T& front() const;
+		void pop_front();
+		// i-th element counting from the front
+		T& operator[](unsigned int i);
+		const T& operator[](unsigned int i) const;
+		void clear();
+
+	private:
+		typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+		T* slot(unsigned int i);
+		const T* slot(unsigned int i) const;
+		void grow();
+
+		std::unique_ptr<Slot[]> mSlots;
+		unsigned int mCapacity;
+		unsigned int mHead;
+		unsigned int mSize;
+};
+
+template<typename T>
+RingBuffer<T>::RingBuffer(unsigned int capacity)
+	: mCapacity(1),
+	mHead(0),
+	mSize(0)
+{
+	while(mCapacity < capacity)
+		mCapacity *= 2;
+	mSlots.reset(new Slot[mCapacity]);
+}
+
+template<typename T>
+RingBuffer<T>::RingBuffer(const RingBuffer& oth)
+	: mSlots(new Slot[oth.mCapacity]),
+	mCapacity(oth.mCapacity),
+	mHead(0),
+	mSize(0)
+{
+	for(unsigned int i = 0; i < oth.size(); i++)
+		push_back(oth[i]);
+}
+
+template<typename T>
+RingBuffer<T>& RingBuffer<T>::operator=(const RingBuffer& oth)
+{
+	if(this != &oth) {
+		RingBuffer tmp(oth);
+		clear();
+		mSlots.swap(tmp.mSlots);
+		std::swap(mCapacity, tmp.mCapacity);
+		std::swap(mHead, tmp.mHead);
+		std::swap(mSize, tmp.mSize);
+	}
+	return *this;
+}
+
+template<typename T>
+RingBuffer<T>::~RingBuffer()
+{
+	clear();
+}
+
+template<typename T>
+bool RingBuffer<T>::empty() const
+{
+	return mSize == 0;
+}
+
+template<typename T>
+unsigned int RingBuffer<T>::size() const
+{
+	return mSize;
+}
+
+template<typename T>
+unsigned int RingBuffer<T>::capacity() const
+{
+	return mCapacity;
+}
+
+template<typename T>
+void RingBuffer<T>::push_back(const T& t)
+{
+	if(mSize == mCapacity)
+		grow();
+	new(slot(mSize)) T(t);
+	mSize++;
+}
+
+template<typename T>
+T& RingBuffer<T>::front()
+{
+	assert(mSize);
+	return *slot(0);
+}
+
+template<typename T>
+const T& RingBuffer<T>::front() const
+{
+	assert(mSize);
+	return *slot(0);
+}
+
+template<typename T>
+void RingBuffer<T>::pop_front()
+{
+	assert(mSize);
+	slot(0)->~T();
+	mHead = (mHead + 1) & (mCapacity - 1);
+	mSize--;
+}
+
+template<typename T>
+T& RingBuffer<T>::operator[](unsigned int i)
+{
+	assert(i < mSize);
+	return *slot(i);
+}
+
+template<typename T>
+const T& RingBuffer<T>::operator[](unsigned int i) const
+{
+	assert(i < mSize);
+	return *slot(i);
+}
+
+template<typename T>
+void RingBuffer<T>::clear()
+{
+	while(!empty())
+		pop_front();
+	mHead = 0;
+}
+
+template<typename T>
+T* RingBuffer<T>::slot(unsigned int i)
+{
+	return reinterpret_cast<T*>(&mSlots[(mHead + i) & (mCapacity - 1)]);
+}
+
+template<typename T>
+const T* RingBuffer<T>::slot(unsigned int i) const
+{
+	return reinterpret_cast<const T*>(&mSlots[(mHead + i) & (mCapacity - 1)]);
+}
+
+template<typename T>
+void RingBuffer<T>::grow()
+{
+	std::unique_ptr<Slot[]> slots(new Slot[mCapacity * 2]);
+	for(unsigned int i = 0; i < mSize; i++) {
+		T* t = slot(i);
+		new(&slots[i]) T(std::move(*t));
+		t->~T();
+	}
+	mSlots.swap(slots);
+	mCapacity *= 2;
+	mHead = 0;
+}
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,70 @@
+#ifndef PANICFIRE_COMMON_RNG_H
+#define PANICFIRE_COMMON_RNG_H
+
+#include <stdint.h>
+
+namespace PanicFire {
+
+namespace Common {
+
+enum class RngStream {
+	Map,
+	Placement,
+	AI
+};
+
+// PCG32 random number generator. Each object has its own 16 bytes of
+// state, so separate worlds can draw numbers concurrently and get the
+// same sequence for the same seed. Different streams for the same seed
+// give independent sequences.
+class Rng {
+	public:
+		Rng(uint64_t seed = 0, RngStream stream = RngStream::Map, unsigned int substream = 0);
+		void seed(uint64_t seed, RngStream stream, unsigned int substream = 0);
+		uint32_t next();
+		// returns a number between [a, b)
+		int uniform(int a, int b);
+
+	private:
+		uint64_t mState;
+		uint64_t mInc;
+};
+
+inline Rng::Rng(uint64_t s, RngStream stream, unsigned int substream)
+{
+	seed(s, stream, substream);
+}
+
+inline void Rng::seed(uint64_t s, RngStream stream, unsigned int substream)
+{
+	uint64_t seq = (uint64_t(stream) << 32) | substream;
+	mState = 0;
+	mInc = (seq << 1) | 1;
+	next();
+	mState += s;
+	next();
+}
+
+inline uint32_t Rng::next()
+{
+	uint64_t old = mState;
+	mState = old * 6364136223846793005ULL + mInc;
+	uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+	uint32_t rot = old >> 59;
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+inline int Rng::uniform(int a, int b)
+{
+	if(b <= a)
+		return a;
+	uint32_t range = b - a;
+	return a + int((uint64_t(next()) * range) >> 32);
+}
+
+}
+
+}
+
+#endif
+
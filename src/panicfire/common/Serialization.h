@@ -0,0 +1,171 @@
+#ifndef PANICFIRE_COMMON_SERIALIZATION_H
+#define PANICFIRE_COMMON_SERIALIZATION_H
+
+#include <stdint.h>
+
+#include <vector>
+#include <stdexcept>
+
+#include <boost/serialization/array_wrapper.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/level.hpp>
+#include <boost/serialization/tracking.hpp>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/common/MapCodec.h"
+
+// boost::serialization support for the world state. All types are
+// serialized without class information or object tracking, so records
+// written one after another in a binary archive can be read back
+// starting at any record boundary.
+
+namespace boost {
+
+namespace serialization {
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::SoldierID& s, const unsigned int version)
+{
+	ar & s.id;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::TeamID& t, const unsigned int version)
+{
+	ar & t.id;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::Position& p, const unsigned int version)
+{
+	ar & p.x;
+	ar & p.y;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::Health& h, const unsigned int version)
+{
+	ar & h.value;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::APs& a, const unsigned int version)
+{
+	ar & a.value;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::SoldierData& s, const unsigned int version)
+{
+	ar & s.id;
+	ar & s.teamid;
+	ar & s.position;
+	ar & s.health;
+	ar & s.direction;
+	ar & s.aps;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::TeamData& t, const unsigned int version)
+{
+	ar & t.id;
+	for(auto& s : t.soldiers)
+		ar & s;
+}
+
+template<class Archive>
+void serialize(Archive& ar, PanicFire::Common::WorldState& w, const unsigned int version)
+{
+	ar & w.map;
+	for(auto& t : w.teams)
+		ar & t;
+	for(auto& s : w.soldiers)
+		ar & s;
+	ar & w.currentteam;
+	for(auto& i : w.currentsoldierindex)
+		ar & i;
+}
+
+}
+
+}
+
+#define PANICFIRE_SERIALIZE_PLAIN(T) \
+	BOOST_CLASS_IMPLEMENTATION(T, boost::serialization::object_serializable) \
+	BOOST_CLASS_TRACKING(T, boost::serialization::track_never)
+
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::SoldierID)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::TeamID)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::Position)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::Health)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::APs)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::SoldierData)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::TeamData)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::MapData)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::WorldState)
+PANICFIRE_SERIALIZE_PLAIN(PanicFire::Common::WorldData)
+
+#undef PANICFIRE_SERIALIZE_PLAIN
+
+namespace PanicFire {
+
+namespace Common {
+
+template<class Archive>
+void MapData::serialize(Archive& ar, const unsigned int version)
+{
+	boost::serialization::split_member(ar, *this, version);
+}
+
+template<class Archive>
+void MapData::save(Archive& ar, const unsigned int version) const
+{
+	// see panicfire/common/MapCodec.h
+	std::vector<unsigned char> buf;
+	encodeMap(*this, buf);
+	uint32_t size = buf.size();
+	ar << size;
+	ar << boost::serialization::make_array(buf.data(), size);
+}
+
+template<class Archive>
+void MapData::load(Archive& ar, const unsigned int version)
+{
+	uint32_t size;
+	ar >> size;
+	// don't let a corrupt size allocate gigabytes
+	if(size > MaxEncodedMapSize)
+		throw std::runtime_error("MapData: map too large");
+	std::vector<unsigned char> buf(size);
+	ar >> boost::serialization::make_array(buf.data(), size);
+	if(decodeMap(buf.data(), size, *this) != size)
+		throw std::runtime_error("MapData: trailing bytes after map");
+}
+
+template<class Archive>
+void WorldData::serialize(Archive& ar, const unsigned int version)
+{
+	boost::serialization::split_member(ar, *this, version);
+}
+
+template<class Archive>
+void WorldData::save(Archive& ar, const unsigned int version) const
+{
+	const WorldState s = getState();
+	ar << s;
+}
+
+template<class Archive>
+void WorldData::load(Archive& ar, const unsigned int version)
+{
+	WorldState s;
+	ar >> s;
+	setState(s);
+}
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,107 @@
+#ifndef PANICFIRE_COMMON_SPSCQUEUE_H
+#define PANICFIRE_COMMON_SPSCQUEUE_H
+
+#include <new>
+#include <memory>
+#include <atomic>
+#include <type_traits>
+
+namespace PanicFire {
+
+namespace Common {
+
+// Bounded lock-free queue for exactly one producer thread and one
+// consumer thread. The consumer reads an element in place with front()
+// and releases it with pop(), so T doesn't need to be default
+// constructible.
+template<typename T>
+class SpscQueue {
+	public:
+		SpscQueue(unsigned int capacity = 1024);
+		~SpscQueue();
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		// producer side - returns false if the queue is full
+		bool push(const T& t);
+
+		// consumer side - front returns nullptr if the queue is empty
+		T* front();
+		void pop();
+
+	private:
+		typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+		T* slot(unsigned int i);
+
+		std::unique_ptr<Slot[]> mSlots;
+		unsigned int mMask;
+		// keep the indices on separate cache lines
+		char mPad0[64];
+		std::atomic<unsigned int> mHead; // next element to pop
+		char mPad1[64];
+		std::atomic<unsigned int> mTail; // next free slot
+		char mPad2[64];
+};
+
+template<typename T>
+SpscQueue<T>::SpscQueue(unsigned int capacity)
+	: mHead(0),
+	mTail(0)
+{
+	unsigned int c = 1;
+	while(c < capacity)
+		c *= 2;
+	mSlots.reset(new Slot[c]);
+	mMask = c - 1;
+}
+
+template<typename T>
+SpscQueue<T>::~SpscQueue()
+{
+	while(front())
+		pop();
+}
+
+template<typename T>
+bool SpscQueue<T>::push(const T& t)
+{
+	unsigned int tail = mTail.load(std::memory_order_relaxed);
+	unsigned int head = mHead.load(std::memory_order_acquire);
+	if(tail - head > mMask)
+		return false;
+	new(slot(tail)) T(t);
+	mTail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+T* SpscQueue<T>::front()
+{
+	unsigned int head = mHead.load(std::memory_order_relaxed);
+	unsigned int tail = mTail.load(std::memory_order_acquire);
+	if(head == tail)
+		return nullptr;
+	return slot(head);
+}
+
+template<typename T>
+void SpscQueue<T>::pop()
+{
+	unsigned int head = mHead.load(std::memory_order_relaxed);
+	slot(head)->~T();
+	mHead.store(head + 1, std::memory_order_release);
+}
+
+template<typename T>
+T* SpscQueue<T>::slot(unsigned int i)
+{
+	return reinterpret_cast<T*>(&mSlots[i & mMask]);
+}
+
+}
+
+}
+
+#endif
+
@@ -1,10 +1,11 @@
 #include <string.h>
 
+#include <algorithm>
+#include <array>
 #include <stdexcept>
 
-#include "common/Random.h"
-
 #include "panicfire/common/Structures.h"
+#include "panicfire/common/LineWalker.h"
 
 #define SHOT_APS_REQUIRED	8
 
@@ -24,29 +25,136 @@ float Position::distance(const Position& oth) const
 	return sqrt(xd * xd + yd * yd);
 }
 
-void MapData::generate(unsigned int w, unsigned int h)
+MapData::Layers::Layers(unsigned int n)
+	: terrainstore(n),
+	blockedstore(n),
+	coststore(n)
 {
-	width = w;
-	height = h;
-	data.resize(width * height);
-	for(unsigned int j = 0; j < width; j++) {
-		for(unsigned int i = 0; i < height; i++) {
-			int gl = ::Common::Random::uniform(2, 5);
-			int v = ::Common::Random::uniform(0, 3);
-			int r = ::Common::Random::uniform(1, 4);
-			data[j * height + i].grasslevel = static_cast<GrassLevel>(gl);
+	terrain = terrainstore.data();
+	blocked = blockedstore.view();
+	cost = coststore.data();
+}
+
+MapData::Layers::Layers(const Layers& l)
+	: terrainstore(l.terrain, l.terrain + l.blocked.size()),
+	blockedstore(l.blocked),
+	coststore(l.cost, l.cost + l.blocked.size())
+{
+	terrain = terrainstore.data();
+	blocked = blockedstore.view();
+	cost = coststore.data();
+}
+
+MapData::MapData()
+{
+	// all empty maps share the same (empty) layers
+	static const std::shared_ptr<Layers> empty = std::make_shared<Layers>();
+	layers = empty;
+}
+
+void MapData::generate(unsigned int w, unsigned int h, Rng& rng)
+{
+	auto l = std::make_shared<Layers>(w * h);
+	for(unsigned int j = 0; j < h; j++) {
+		for(unsigned int i = 0; i < w; i++) {
+			MapFragment f;
+			int gl = rng.uniform(2, 5);
+			int v = rng.uniform(0, 3);
+			int r = rng.uniform(1, 4);
+			f.grasslevel = static_cast<GrassLevel>(gl);
 			if(v == 0) {
-				data[j * height + i].vegetationlevel = static_cast<VegetationLevel>(r);
+				f.vegetationlevel = static_cast<VegetationLevel>(r);
 			}
+			setTile(*l, j * w + i, f);
+		}
+	}
+	width = w;
+	height = h;
+	layers = l;
+}
+
+const std::array<MapData::Derived, 256>& MapData::derivedLayers()
+{
+	static const std::array<Derived, 256> derived = []() {
+		std::array<Derived, 256> d;
+		for(unsigned int t = 0; t < 256; t++) {
+			MapFragment f = unpackFragment(t);
+			bool valid = packFragment(f) == t &&
+				f.vegetationlevel <= VegetationLevel::Rock &&
+				f.grasslevel <= GrassLevel::High;
+			d[t].cost = valid ? movementCost(f.grasslevel) : 0;
+			d[t].blocked = f.wall || f.vegetationlevel != VegetationLevel::None;
 		}
+		return d;
+	}();
+	return derived;
+}
+
+void MapData::assign(unsigned int w, unsigned int h, const unsigned char* terrain)
+{
+	const std::array<Derived, 256>& derived = derivedLayers();
+	auto l = std::make_shared<Layers>(w * h);
+	std::copy(terrain, terrain + w * h, l->terrainstore.begin());
+	for(unsigned int i = 0; i < w * h; i++) {
+		const Derived& d = derived[terrain[i]];
+		if(!d.cost)
+			throw std::runtime_error("MapData: invalid terrain");
+		l->coststore[i] = d.cost;
+		if(d.blocked)
+			l->blockedstore.set(i);
 	}
+	width = w;
+	height = h;
+	layers = l;
 }
 
-const MapFragment& MapData::getPoint(unsigned int x, unsigned int y) const
+void MapData::assignView(unsigned int w, unsigned int h, const unsigned char* terrain,
+		const unsigned char* cost, const uint64_t* blocked,
+		std::shared_ptr<const void> owner)
+{
+	// the same checks as assign(), and the given layers must be the
+	// ones derived from the terrain
+	const std::array<Derived, 256>& derived = derivedLayers();
+	BitsetView bv(blocked, w * h);
+	for(unsigned int i = 0; i < w * h; i++) {
+		const Derived& d = derived[terrain[i]];
+		if(!d.cost)
+			throw std::runtime_error("MapData: invalid terrain");
+		if(cost[i] != d.cost || bv.test(i) != d.blocked)
+			throw std::runtime_error("MapData: layers don't match the terrain");
+	}
+
+	auto l = std::make_shared<Layers>();
+	l->terrain = terrain;
+	l->blocked = BitsetView(blocked, w * h);
+	l->cost = cost;
+	l->owner = owner;
+	width = w;
+	height = h;
+	layers = l;
+}
+
+MapFragment MapData::getPoint(unsigned int x, unsigned int y) const
 {
 	if(x >= width || y >= height)
 		throw std::runtime_error("MapData: access outside boundary");
-	return data[y * height + x];
+	return getFragment(y * width + x);
+}
+
+void MapData::setPoint(unsigned int x, unsigned int y, const MapFragment& f)
+{
+	if(x >= width || y >= height)
+		throw std::runtime_error("MapData: access outside boundary");
+	if(layers.use_count() > 1 || layers->owner)
+		layers = std::make_shared<Layers>(*layers);
+	setTile(*layers, y * width + x, f);
+}
+
+void MapData::setTile(Layers& l, unsigned int i, const MapFragment& f)
+{
+	l.terrainstore[i] = packFragment(f);
+	l.blockedstore.assign(i, f.wall || f.vegetationlevel != VegetationLevel::None);
+	l.coststore[i] = movementCost(f.grasslevel);
 }
 
 unsigned int MapData::getWidth() const
@@ -78,14 +186,82 @@ unsigned int MapData::movementCost(GrassLevel g)
 
 unsigned int MapData::movementCost(const Position& p) const
 {
-	auto& f = getPoint(p.x, p.y);
-	return MapData::movementCost(f.grasslevel);
+	if(!inside(p))
+		throw std::runtime_error("MapData: access outside boundary");
+	return layers->cost[tileIndex(p)];
 }
 
 bool MapData::positionBlocked(const Position& p) const
 {
-	auto& f = getPoint(p.x, p.y);
-	return f.wall || f.vegetationlevel != VegetationLevel::None;
+	if(!inside(p))
+		throw std::runtime_error("MapData: access outside boundary");
+	return layers->blocked.test(tileIndex(p));
+}
+
+const unsigned int TraceCache::NumEntries;
+
+TraceCache::TraceCache()
+	: mHits(0),
+	mMisses(0)
+{
+}
+
+TraceCache::TraceCache(const TraceCache& oth)
+	: TraceCache()
+{
+}
+
+TraceCache& TraceCache::operator=(const TraceCache& oth)
+{
+	// keeps the statistics, as they're about this cache
+	mEntries.clear();
+	return *this;
+}
+
+unsigned int TraceCache::slot(const Position& from, const Position& to)
+{
+	uint32_t h = from.x * 73856093u ^ from.y * 19349663u ^
+		to.x * 83492791u ^ to.y * 2654435761u;
+	return (h ^ (h >> 16)) & (NumEntries - 1);
+}
+
+bool TraceCache::find(const Position& from, const Position& to,
+		uint64_t mapversion, uint64_t occversion, Position& result)
+{
+	if(!mEntries.empty()) {
+		const Entry& e = mEntries[slot(from, to)];
+		if(e.occversion == occversion && e.mapversion == mapversion &&
+				e.from == from && e.to == to) {
+			result = e.result;
+			mHits++;
+			return true;
+		}
+	}
+	mMisses++;
+	return false;
+}
+
+void TraceCache::insert(const Position& from, const Position& to,
+		uint64_t mapversion, uint64_t occversion, const Position& result)
+{
+	if(mEntries.empty())
+		mEntries.resize(NumEntries, Entry{Position(), Position(), Position(), 0, 0});
+	Entry& e = mEntries[slot(from, to)];
+	e.from = from;
+	e.to = to;
+	e.result = result;
+	e.mapversion = mapversion;
+	e.occversion = occversion;
+}
+
+uint64_t TraceCache::getHits() const
+{
+	return mHits;
+}
+
+uint64_t TraceCache::getMisses() const
+{
+	return mMisses;
 }
 
 WorldData::WorldData()
@@ -94,9 +270,24 @@ WorldData::WorldData()
 		s = 0;
 }
 
-WorldData::WorldData(unsigned int w, unsigned int h, unsigned int nsoldiers)
+static MapData generateMap(unsigned int w, unsigned int h, uint64_t seed)
 {
-	mMapData.generate(w, h);
+	MapData m;
+	Rng maprng(seed, RngStream::Map);
+	m.generate(w, h, maprng);
+	return m;
+}
+
+WorldData::WorldData(unsigned int w, unsigned int h, unsigned int nsoldiers, uint64_t seed)
+	: WorldData(generateMap(w, h, seed), nsoldiers, seed)
+{
+}
+
+WorldData::WorldData(const MapData& map, unsigned int nsoldiers, uint64_t seed)
+	: mMapData(map)
+{
+	unsigned int w = mMapData.getWidth();
+	unsigned int h = mMapData.getHeight();
 	nsoldiers = std::min(static_cast<unsigned int>(MAX_TEAM_SOLDIERS), nsoldiers);
 	unsigned int sid = 1;
 	for(unsigned int i = 0; i < MAX_NUM_TEAMS; i++) {
@@ -120,52 +311,37 @@ WorldData::WorldData(unsigned int w, unsigned int h, unsigned int nsoldiers)
 		}
 	}
 
-	generateSoldierPositions();
+	Rng placementrng(seed, RngStream::Placement);
+	generateSoldierPositions(placementrng);
+	rebuildOccupancy();
 
 	mCurrentTeamID = 1;
 	for(auto &s : mCurrentSoldierIDIndex)
 		s = 0;
 }
 
-bool WorldData::sync(WorldInterface& wi)
+WorldData::WorldData(const WorldState& s)
 {
-	{
-		Common::QueryResult qr = wi.query(Common::MapQuery());
-		if(!boost::apply_visitor(*this, qr)) {
-			std::cerr << "Map query failed.\n";
-			return false;
-		}
-		assert(this->getMapData());
-	}
+	setState(s);
+}
 
-	for(unsigned int i = 1; i <= MAX_NUM_TEAMS; i++) {
-		TeamID tid = TeamID(i);
-		Common::QueryResult qr = wi.query(Common::TeamQuery(tid));
-		if(!boost::apply_visitor(*this, qr)) {
-			std::cerr << "Team query failed for team " << tid.id << ".\n";
-			return false;
-		}
-		TeamData* td = getTeam(tid);
-		assert(td);
-		if(td) {
-			for(unsigned int j = 0; j < MAX_TEAM_SOLDIERS; j++) {
-				if(!td->soldiers[j].id)
-					continue;
-				SoldierID sid = td->soldiers[j];
-				Common::QueryResult qr2 = wi.query(Common::SoldierQuery(sid));
-				if(!boost::apply_visitor(*this, qr2)) {
-					std::cerr << "Soldier query failed for soldier " << sid.id << ".\n";
-					return false;
-				}
-			}
-		}
-	}
+void setViewer(Query& q, TeamID viewer)
+{
+	if(auto sq = boost::get<SoldierQuery>(&q))
+		sq->viewer = viewer;
+	else if(auto sq = boost::get<SnapshotQuery>(&q))
+		sq->viewer = viewer;
+}
 
-	Common::QueryResult qr = wi.query(Common::CurrentSoldierQuery());
+bool WorldData::sync(WorldInterface& wi, TeamID viewer)
+{
+	mViewer = viewer;
+	Common::QueryResult qr = wi.query(Common::SnapshotQuery(true, viewer));
 	if(!boost::apply_visitor(*this, qr)) {
-		std::cerr << "Current soldier query failed.\n";
+		std::cerr << "Snapshot query failed.\n";
 		return false;
 	}
+	assert(this->getMapData());
 
 	return true;
 }
@@ -212,11 +388,6 @@ SoldierData* WorldData::getSoldier(SoldierID s)
 	}
 }
 
-MapData* WorldData::getMapData()
-{
-	return &mMapData;
-}
-
 SoldierData& WorldData::getCurrentSoldier()
 {
 	auto td = getTeam(mCurrentTeamID);
@@ -264,6 +435,55 @@ const SoldierData& WorldData::getCurrentSoldier() const
 	return mSoldierData[sindex];
 }
 
+WorldState WorldData::getState() const
+{
+	WorldState s;
+	s.map = mMapData;
+	s.teams = mTeamData;
+	s.soldiers = mSoldierData;
+	s.currentteam = mCurrentTeamID;
+	s.currentsoldierindex = mCurrentSoldierIDIndex;
+	return s;
+}
+
+void WorldData::setState(const WorldState& s)
+{
+	// the ids must match their slots and the current soldiers must
+	// exist, or getCurrentSoldier() would index past the arrays
+	for(unsigned int i = 0; i < s.soldiers.size(); i++) {
+		const SoldierData& sd = s.soldiers[i];
+		if(sd.id.id && (sd.id.id != i + 1 || !sd.teamid.id ||
+					sd.teamid.id > MAX_NUM_TEAMS ||
+					sd.direction > Direction::SE))
+			throw std::runtime_error("WorldData: invalid soldier");
+	}
+	for(unsigned int i = 0; i < s.teams.size(); i++) {
+		const TeamData& td = s.teams[i];
+		if(td.id.id != i + 1)
+			throw std::runtime_error("WorldData: invalid team");
+		for(auto sid : td.soldiers) {
+			if(sid.id && (sid.id > s.soldiers.size() ||
+						s.soldiers[sid.id - 1].id != sid ||
+						s.soldiers[sid.id - 1].teamid != td.id))
+				throw std::runtime_error("WorldData: invalid team");
+		}
+		if(s.currentsoldierindex[i] >= MAX_TEAM_SOLDIERS)
+			throw std::runtime_error("WorldData: invalid current soldier");
+	}
+	if(!s.currentteam.id || s.currentteam.id > MAX_NUM_TEAMS)
+		throw std::runtime_error("WorldData: invalid current team");
+	unsigned int tindex = teamIndexFromTeamID(s.currentteam);
+	if(!s.teams[tindex].soldiers[s.currentsoldierindex[tindex]].id)
+		throw std::runtime_error("WorldData: invalid current soldier");
+
+	mMapData = s.map;
+	mTeamData = s.teams;
+	mSoldierData = s.soldiers;
+	mCurrentTeamID = s.currentteam;
+	mCurrentSoldierIDIndex = s.currentsoldierindex;
+	rebuildOccupancy();
+}
+
 SoldierID WorldData::getCurrentSoldierID() const
 {
 	return getCurrentSoldier().id;
@@ -315,8 +535,16 @@ bool WorldData::operator()(const Common::SoldierQueryResult& q)
 		assert(0);
 		return false;
 	}
+	Position oldpos = mSoldierData[index].position;
+	bool wasalive = mSoldierData[index].alive();
+	vacate(index);
 	mSoldierData[index] = q.soldier;
-	std::cout << "Soldier query successful.\n";
+	occupy(index);
+	// syncing usually doesn't change anything
+	if(oldpos != q.soldier.position || wasalive != q.soldier.alive()) {
+		mOccupancyVersion++;
+		updateLines(index, oldpos);
+	}
 	return true;
 }
 
@@ -329,14 +557,13 @@ bool WorldData::operator()(const Common::TeamQueryResult& q)
 		return false;
 	}
 	mTeamData[index] = q.team;
-	std::cout << "Team query successful for team " << mTeamData[index].id.id << ".\n";
 	return true;
 }
 
 bool WorldData::operator()(const Common::MapQueryResult& q)
 {
-	std::cout << "Map query successful.\n";
 	mMapData = q.map;
+	rebuildOccupancy();
 	return true;
 }
 
@@ -363,6 +590,20 @@ bool WorldData::operator()(const Common::CurrentSoldierQueryResult& q)
 	}
 }
 
+bool WorldData::operator()(const Common::SnapshotQueryResult& q)
+{
+	if(q.hasmap)
+		mMapData = q.map;
+	mTeamData = q.teams;
+	mSoldierData = q.soldiers;
+	rebuildOccupancy();
+
+	CurrentSoldierQueryResult cq;
+	cq.team = q.currentteam;
+	cq.soldier = q.currentsoldier;
+	return (*this)(cq);
+}
+
 bool WorldData::operator()(const Common::DeniedQueryResult& q)
 {
 	std::cerr << "WorldData error: denied query.\n";
@@ -379,7 +620,13 @@ bool WorldData::operator()(const Common::MovementInput& ev)
 {
 	auto sd = getSoldier(ev.mover);
 	assert(sd);
+	unsigned int sindex = soldierIndexFromSoldierID(ev.mover);
+	Position oldpos = sd->position;
+	vacate(sindex);
 	sd->position = ev.to;
+	occupy(sindex);
+	mOccupancyVersion++;
+	updateLines(sindex, oldpos);
 	sd->aps.value -= mMapData.movementCost(ev.to);
 	sd->direction = getDirection(ev.from, ev.to);
 	return false;
@@ -406,6 +653,31 @@ bool WorldData::operator()(const Common::InputEvent& ev)
 
 bool WorldData::operator()(const Common::SightingEvent& ev)
 {
+	auto sd = getSoldier(ev.seen);
+	if(!sd)
+		return false;
+	Position newpos;
+	if(ev.visible) {
+		// the soldier may have moved while out of sight
+		if(!mMapData.inside(ev.position))
+			return false;
+		newpos = ev.position;
+	} else {
+		// hide the soldier like the world's queries do for the
+		// viewer; a spectator sees everyone
+		if(!mViewer.id || sd->teamid == mViewer)
+			return false;
+		newpos = Position(~0u, ~0u);
+	}
+	unsigned int sindex = soldierIndexFromSoldierID(ev.seen);
+	Position oldpos = sd->position;
+	vacate(sindex);
+	sd->position = newpos;
+	occupy(sindex);
+	if(oldpos != newpos) {
+		mOccupancyVersion++;
+		updateLines(sindex, oldpos);
+	}
 	return false;
 }
 
@@ -418,6 +690,12 @@ bool WorldData::operator()(const Common::SoldierWoundedEvent& ev)
 	}
 
 	sd->health = ev.newhealth;
+	if(!sd->alive()) {
+		unsigned int sindex = soldierIndexFromSoldierID(ev.wounded);
+		vacate(sindex);
+		mOccupancyVersion++;
+		updateLines(sindex, sd->position);
+	}
 
 	return false;
 }
@@ -451,11 +729,16 @@ bool WorldData::movementAllowed(const MovementInput& i) const
 		return false;
 	}
 
-	if(sd->aps.value < mMapData.movementCost(i.to)) {
+	if(!mMapData.inside(i.to)) {
 		return false;
 	}
 
-	if(mMapData.positionBlocked(i.to)) {
+	unsigned int toindex = mMapData.tileIndex(i.to);
+	if(sd->aps.value < mMapData.cost(toindex)) {
+		return false;
+	}
+
+	if(mMapData.blocked(toindex)) {
 		return false;
 	}
 
@@ -489,25 +772,27 @@ bool WorldData::shotAllowed(const ShotInput& i) const
 		return false;
 	}
 
+	if(!mMapData.inside(i.target)) {
+		return false;
+	}
+
 	return true;
 }
 
 SoldierData* WorldData::getSoldierAt(const Position& p)
 {
-	for(auto& s : mSoldierData) {
-		if(s.position == p && s.health.value > 0)
-			return &s;
-	}
-	return nullptr;
+	if(!mMapData.inside(p))
+		return nullptr;
+	unsigned int o = mOccupant[mMapData.tileIndex(p)];
+	return o ? &mSoldierData[o - 1] : nullptr;
 }
 
 const SoldierData* WorldData::getSoldierAt(const Position& p) const
 {
-	for(auto& s : mSoldierData) {
-		if(s.position == p && s.health.value > 0)
-			return &s;
-	}
-	return nullptr;
+	if(!mMapData.inside(p))
+		return nullptr;
+	unsigned int o = mOccupant[mMapData.tileIndex(p)];
+	return o ? &mSoldierData[o - 1] : nullptr;
 }
 
 bool WorldData::teamLost(TeamID tid) const
@@ -528,24 +813,172 @@ bool WorldData::teamLost(TeamID tid) const
 	return true;
 }
 
-std::set<Position> WorldData::getSoldierPositions() const
+const Bitset& WorldData::getSoldierPositions() const
+{
+	return mOccupied;
+}
+
+Position WorldData::traceShot(const Position& from, const Position& to) const
+{
+	Position res;
+	if(mTraceCache.find(from, to, mMapVersion, mOccupancyVersion, res))
+		return res;
+
+	res = to;
+	LineWalker w(from, to);
+	unsigned int steps = 0;
+	while(!w.atEnd()) {
+		w.next();
+		if(++steps < 2)
+			continue;
+		unsigned int i = mMapData.tileIndex(w.position());
+		if(mMapData.blocked(i) || mOccupied.test(i)) {
+			res = w.position();
+			break;
+		}
+	}
+	mTraceCache.insert(from, to, mMapVersion, mOccupancyVersion, res);
+	return res;
+}
+
+const TraceCache& WorldData::getTraceCache() const
+{
+	return mTraceCache;
+}
+
+bool WorldData::inLineOfSight(SoldierID from, SoldierID to) const
+{
+	unsigned int i = soldierIndexFromSoldierID(from);
+	unsigned int j = soldierIndexFromSoldierID(to);
+	if(i >= mSoldierData.size() || j >= mSoldierData.size())
+		return false;
+	return mLineOfSight.test(i * mSoldierData.size() + j);
+}
+
+bool WorldData::inLineOfFire(SoldierID from, SoldierID to) const
+{
+	unsigned int i = soldierIndexFromSoldierID(from);
+	unsigned int j = soldierIndexFromSoldierID(to);
+	if(i >= mSoldierData.size() || j >= mSoldierData.size())
+		return false;
+	return mLineOfFire.test(i * mSoldierData.size() + j);
+}
+
+void WorldData::rebuildLines()
+{
+	unsigned int n = mSoldierData.size();
+	mLineOfSight.resize(n * n);
+	mLineOfFire.resize(n * n);
+	for(unsigned int i = 0; i < n; i++) {
+		for(unsigned int j = 0; j < n; j++)
+			traceLines(i, j);
+	}
+}
+
+void WorldData::updateLines(unsigned int sindex, const Position& oldpos)
+{
+	unsigned int n = mSoldierData.size();
+	const Position& newpos = mSoldierData[sindex].position;
+	for(unsigned int i = 0; i < n; i++) {
+		if(i == sindex) {
+			for(unsigned int j = 0; j < n; j++) {
+				traceLines(sindex, j);
+				traceLines(j, sindex);
+			}
+			continue;
+		}
+
+		// the soldier can only have left or entered the lines between
+		// the others that pass its tiles, which lie in their bounding
+		// boxes; the lines blocked by terrain stay blocked
+		const Position& p1 = mSoldierData[i].position;
+		for(unsigned int j = 0; j < n; j++) {
+			if(j == sindex || !mLineOfSight.test(i * n + j))
+				continue;
+			const Position& p2 = mSoldierData[j].position;
+			unsigned int x0 = std::min(p1.x, p2.x);
+			unsigned int x1 = std::max(p1.x, p2.x);
+			unsigned int y0 = std::min(p1.y, p2.y);
+			unsigned int y1 = std::max(p1.y, p2.y);
+			bool oldin = oldpos.x >= x0 && oldpos.x <= x1 && oldpos.y >= y0 && oldpos.y <= y1;
+			bool newin = newpos.x >= x0 && newpos.x <= x1 && newpos.y >= y0 && newpos.y <= y1;
+			if(oldin || newin)
+				traceLines(i, j);
+		}
+	}
+}
+
+// the same walk as traceShot, told apart by what stops it
+void WorldData::traceLines(unsigned int from, unsigned int to)
+{
+	unsigned int bit = from * mSoldierData.size() + to;
+	const SoldierData& sd1 = mSoldierData[from];
+	const SoldierData& sd2 = mSoldierData[to];
+	bool sight = false;
+	bool fire = false;
+	if(from != to && sd1.id.id && sd2.id.id && sd1.alive() && sd2.alive() &&
+			mMapData.inside(sd1.position) && mMapData.inside(sd2.position)) {
+		sight = fire = true;
+		LineWalker w(sd1.position, sd2.position);
+		unsigned int steps = 0;
+		while(sight && !w.atEnd()) {
+			w.next();
+			if(++steps < 2 || w.atEnd())
+				continue;
+			unsigned int i = mMapData.tileIndex(w.position());
+			if(mMapData.blocked(i))
+				sight = fire = false;
+			else if(mOccupied.test(i))
+				fire = false;
+		}
+	}
+	mLineOfSight.assign(bit, sight);
+	mLineOfFire.assign(bit, fire);
+}
+
+void WorldData::rebuildOccupancy()
+{
+	unsigned int numtiles = mMapData.getWidth() * mMapData.getHeight();
+	mOccupant.assign(numtiles, 0);
+	mOccupied.resize(numtiles);
+	for(unsigned int i = 0; i < mSoldierData.size(); i++)
+		occupy(i);
+	// called whenever the map is replaced
+	mMapVersion++;
+	mOccupancyVersion++;
+	rebuildLines();
+}
+
+void WorldData::occupy(unsigned int sindex)
+{
+	const SoldierData& sd = mSoldierData[sindex];
+	if(!sd.alive() || !mMapData.inside(sd.position))
+		return;
+	unsigned int i = mMapData.tileIndex(sd.position);
+	mOccupant[i] = sindex + 1;
+	mOccupied.set(i);
+}
+
+void WorldData::vacate(unsigned int sindex)
 {
-	std::set<Position> ret;
-	for(auto& sd : mSoldierData) {
-		if(sd.health.value > 0)
-			ret.insert(sd.position);
+	const SoldierData& sd = mSoldierData[sindex];
+	if(!mMapData.inside(sd.position))
+		return;
+	unsigned int i = mMapData.tileIndex(sd.position);
+	if(mOccupant[i] == sindex + 1) {
+		mOccupant[i] = 0;
+		mOccupied.reset(i);
 	}
-	return ret;
 }
 
-void WorldData::syncCurrentSoldier(WorldInterface& wi)
+void WorldData::syncCurrentSoldier(WorldInterface& wi, TeamID viewer)
 {
 	Common::QueryResult qr = wi.query(Common::CurrentSoldierQuery());
 	if(!boost::apply_visitor(*this, qr)) {
 		assert(0);
 		throw std::runtime_error("Current soldier query failed");
 	}
-	Common::QueryResult qr2 = wi.query(Common::SoldierQuery(getCurrentSoldierID()));
+	Common::QueryResult qr2 = wi.query(Common::SoldierQuery(getCurrentSoldierID(), viewer));
 	if(!boost::apply_visitor(*this, qr2)) {
 		assert(0);
 		throw std::runtime_error("Soldier query failed when syncing current");
@@ -578,7 +1011,7 @@ Direction WorldData::getDirection(const Position& from, const Position& to)
 	}
 }
 
-void WorldData::generateSoldierPositions()
+void WorldData::generateSoldierPositions(Rng& rng)
 {
 	for(unsigned int i = 0; i < MAX_NUM_TEAMS; i++) {
 		std::array<Position, MAX_TEAM_SOLDIERS> positions;
@@ -592,10 +1025,9 @@ void WorldData::generateSoldierPositions()
 				if(tries > 100) {
 					throw std::runtime_error("Unable to find position for soldier");
 				}
-				p.x = ::Common::Random::uniform(0, mMapData.getWidth());
-				p.y = ::Common::Random::uniform(0, mMapData.getHeight());
+				p.x = rng.uniform(0, mMapData.getWidth());
+				p.y = rng.uniform(0, mMapData.getHeight());
 				if(mMapData.positionBlocked(p)) {
-					std::cout << p << " blocked\n";
 					continue;
 				}
 				bool alreadyused = false;
@@ -603,7 +1035,6 @@ void WorldData::generateSoldierPositions()
 				for(unsigned int l = 0; l < j; l++) {
 					if(p.distance(positions[l]) < 5.0f) {
 						alreadyused = true;
-						std::cout << p << " used in own team\n";
 						break;
 					}
 				}
@@ -616,7 +1047,6 @@ void WorldData::generateSoldierPositions()
 						assert(sd2);
 						if(p.distance(sd2->position) < 5.0f) {
 							alreadyused = true;
-							std::cout << p << " used in opponent team\n";
 							break;
 						}
 					}
@@ -627,7 +1057,6 @@ void WorldData::generateSoldierPositions()
 			}
 			sd->position = p;
 			positions[j] = p;
-			std::cout << sd->id << " at " << p << "\n";
 		}
 	}
 }
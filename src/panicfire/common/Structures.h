@@ -5,11 +5,21 @@
 #include <vector>
 #include <array>
 #include <set>
+#include <memory>
 
 #include <boost/variant.hpp>
 
 #include "common/Math.h"
 
+#include "panicfire/common/Bitset.h"
+#include "panicfire/common/Rng.h"
+
+namespace boost {
+namespace serialization {
+class access;
+}
+}
+
 namespace PanicFire {
 
 namespace Common {
@@ -19,6 +29,7 @@ namespace Common {
 
 #define MAX_HEALTH	100
 #define MAX_APS		25
+#define SIGHT_RADIUS	12
 
 struct SoldierID {
 	SoldierID(unsigned int tid = 0) : id(tid) { }
@@ -207,22 +218,145 @@ struct MapFragment {
 	GrassLevel grasslevel = GrassLevel::Low;
 };
 
+// Tiles are stored as three flat layers indexed by y * width + x:
+// one packed terrain byte per tile, a blocked bitset and a movement
+// cost byte, the latter two derived from the terrain on write.
+//
+// The layers are immutable and shared between copies, so copying a
+// MapData is O(1) regardless of the map size. Writing to a map whose
+// layers are shared makes a private copy first. The layers may also
+// be views of memory owned elsewhere, such as a mapped map file (see
+// panicfire/common/MapFile.h).
 class MapData {
 	public:
-		void generate(unsigned int w, unsigned int h);
-		const MapFragment& getPoint(unsigned int x, unsigned int y) const;
+		MapData();
+		void generate(unsigned int w, unsigned int h, Rng& rng);
+		MapFragment getPoint(unsigned int x, unsigned int y) const;
+		void setPoint(unsigned int x, unsigned int y, const MapFragment& f);
 		unsigned int getWidth() const;
 		unsigned int getHeight() const;
 		static unsigned int movementCost(GrassLevel g);
 		unsigned int movementCost(const Position& p) const;
 		bool positionBlocked(const Position& p) const;
 
+		// unchecked access by tile index for hot loops
+		bool inside(const Position& p) const;
+		unsigned int tileIndex(const Position& p) const;
+		MapFragment getFragment(unsigned int i) const;
+		bool blocked(unsigned int i) const;
+		unsigned int cost(unsigned int i) const;
+		BitsetView getBlockedGrid() const;
+		const unsigned char* getCostGrid() const;
+
+		// packed terrain bytes, one per tile, for encoding the map;
+		// the other layers are derived from these
+		const unsigned char* getTerrainGrid() const;
+		void assign(unsigned int w, unsigned int h, const unsigned char* terrain);
+		// uses the given layers in place, keeping owner alive for as
+		// long as any copy of the map uses them. Throws like assign()
+		// if the layers aren't valid.
+		void assignView(unsigned int w, unsigned int h, const unsigned char* terrain,
+				const unsigned char* cost, const uint64_t* blocked,
+				std::shared_ptr<const void> owner);
+
 	private:
+		// see panicfire/common/Serialization.h
+		friend class boost::serialization::access;
+		template<class Archive> void serialize(Archive& ar, const unsigned int version);
+		template<class Archive> void save(Archive& ar, const unsigned int version) const;
+		template<class Archive> void load(Archive& ar, const unsigned int version);
+
+		// the layers either point to their own storage or to memory
+		// kept alive by owner
+		struct Layers {
+			Layers(unsigned int n = 0);
+			// a copy with its own storage
+			Layers(const Layers& l);
+			Layers& operator=(const Layers&) = delete;
+
+			const unsigned char* terrain;
+			BitsetView blocked;
+			const unsigned char* cost;
+
+			std::vector<unsigned char> terrainstore;
+			Bitset blockedstore;
+			std::vector<unsigned char> coststore;
+			std::shared_ptr<const void> owner;
+		};
+
+		// the derived layers for every possible terrain byte; cost 0
+		// marks bytes that packFragment never produces
+		struct Derived {
+			unsigned char cost;
+			bool blocked;
+		};
+		static const std::array<Derived, 256>& derivedLayers();
+
+		static unsigned char packFragment(const MapFragment& f);
+		static MapFragment unpackFragment(unsigned char t);
+		static void setTile(Layers& l, unsigned int i, const MapFragment& f);
+
 		unsigned int width = 0;
 		unsigned int height = 0;
-		std::vector<MapFragment> data;
+		std::shared_ptr<Layers> layers;
 };
 
+inline bool MapData::inside(const Position& p) const
+{
+	return p.x < width && p.y < height;
+}
+
+inline unsigned int MapData::tileIndex(const Position& p) const
+{
+	return p.y * width + p.x;
+}
+
+inline MapFragment MapData::getFragment(unsigned int i) const
+{
+	return unpackFragment(layers->terrain[i]);
+}
+
+inline bool MapData::blocked(unsigned int i) const
+{
+	return layers->blocked.test(i);
+}
+
+inline unsigned int MapData::cost(unsigned int i) const
+{
+	return layers->cost[i];
+}
+
+inline BitsetView MapData::getBlockedGrid() const
+{
+	return layers->blocked;
+}
+
+inline const unsigned char* MapData::getCostGrid() const
+{
+	return layers->cost;
+}
+
+inline const unsigned char* MapData::getTerrainGrid() const
+{
+	return layers->terrain;
+}
+
+inline unsigned char MapData::packFragment(const MapFragment& f)
+{
+	return (f.wall ? 0x80 : 0x00) |
+		(static_cast<unsigned char>(f.vegetationlevel) << 3) |
+		static_cast<unsigned char>(f.grasslevel);
+}
+
+inline MapFragment MapData::unpackFragment(unsigned char t)
+{
+	MapFragment f;
+	f.wall = t & 0x80;
+	f.vegetationlevel = static_cast<VegetationLevel>((t >> 3) & 0x07);
+	f.grasslevel = static_cast<GrassLevel>(t & 0x07);
+	return f;
+}
+
 // input
 struct MovementInput {
 	MovementInput(SoldierID i, const Position& fr, const Position& p) : mover(i), from(fr), to(p) { }
@@ -243,9 +377,17 @@ struct FinishTurnInput {
 typedef boost::variant<MovementInput, ShotInput, FinishTurnInput> Input;
 
 // events
+// seen came into sight of seer's team at position, or went out of
+// sight of it if visible is false; a sighting names a seer that sees
+// the soldier, a lost sight doesn't tell where the soldier went
 struct SightingEvent {
+	SightingEvent(SoldierID sr = SoldierID(), SoldierID sn = SoldierID(), bool v = true,
+			const Position& p = Position())
+		: seer(sr), seen(sn), visible(v), position(p) { }
 	SoldierID seer;
 	SoldierID seen;
+	bool visible;
+	Position position;
 };
 
 struct SoldierWoundedEvent {
@@ -270,9 +412,14 @@ struct InputEvent {
 typedef boost::variant<InputEvent, SightingEvent, SoldierWoundedEvent, GameWonEvent, EmptyEvent> Event;
 
 // queries
+// Queries about soldiers name the team asking, the viewer. The world
+// places the enemies the viewer doesn't see outside the map; viewer 0
+// sees everything. Servers set the viewer from the client they serve
+// (see setViewer), so it's only taken on trust in process.
 struct SoldierQuery {
-	SoldierQuery(SoldierID tid) : soldier(tid) { }
+	SoldierQuery(SoldierID tid, TeamID v = TeamID(0)) : soldier(tid), viewer(v) { }
 	SoldierID soldier;
+	TeamID viewer;
 };
 
 struct MapQuery {
@@ -286,7 +433,17 @@ struct TeamQuery {
 struct CurrentSoldierQuery {
 };
 
-typedef boost::variant<SoldierQuery, MapQuery, TeamQuery, CurrentSoldierQuery> Query;
+// everything WorldData::sync needs in one round trip
+struct SnapshotQuery {
+	SnapshotQuery(bool m = true, TeamID v = TeamID(0)) : includemap(m), viewer(v) { }
+	bool includemap;
+	TeamID viewer;
+};
+
+typedef boost::variant<SoldierQuery, MapQuery, TeamQuery, CurrentSoldierQuery,
+	SnapshotQuery> Query;
+
+void setViewer(Query& q, TeamID viewer);
 
 // query results
 struct SoldierQueryResult {
@@ -306,6 +463,15 @@ struct CurrentSoldierQueryResult {
 	SoldierID soldier;
 };
 
+struct SnapshotQueryResult {
+	std::array<TeamData, MAX_NUM_TEAMS> teams;
+	std::array<SoldierData, MAX_NUM_TEAMS * MAX_TEAM_SOLDIERS> soldiers;
+	TeamID currentteam;
+	SoldierID currentsoldier;
+	bool hasmap = false;
+	MapData map;
+};
+
 struct InvalidQueryResult {
 };
 
@@ -313,7 +479,8 @@ struct DeniedQueryResult {
 };
 
 typedef boost::variant<SoldierQueryResult, MapQueryResult, TeamQueryResult,
-	CurrentSoldierQueryResult, InvalidQueryResult, DeniedQueryResult> QueryResult;
+	CurrentSoldierQueryResult, SnapshotQueryResult,
+	InvalidQueryResult, DeniedQueryResult> QueryResult;
 
 // interface
 class WorldInterface {
@@ -322,20 +489,77 @@ class WorldInterface {
 		virtual QueryResult query(const Query& q) = 0;
 		virtual bool input(const Input& i) = 0;
 		virtual Event pollEvents(TeamID tid) = 0;
+		// appends all pending events for the team to out, returns the
+		// number of events appended
+		virtual unsigned int pollEvents(TeamID tid, std::vector<Event>& out) = 0;
+};
+
+// The part of a WorldData that's saved: everything else is rebuilt from
+// this on load. Copying one is cheap since the map layers are shared.
+struct WorldState {
+	MapData map;
+	std::array<TeamData, MAX_NUM_TEAMS> teams;
+	std::array<SoldierData, MAX_NUM_TEAMS * MAX_TEAM_SOLDIERS> soldiers;
+	TeamID currentteam;
+	std::array<unsigned int, MAX_NUM_TEAMS> currentsoldierindex;
+};
+
+// A bounded cache of shot traces, one slot per hash of the end points.
+// Each entry remembers the map and occupancy versions it was traced
+// at, so bumping a version invalidates the entries without touching
+// them. The table is allocated on first use and isn't copied: a copy
+// or an assigned-to cache starts out empty, which keeps copying a
+// WorldData cheap and never carries results over to another state.
+class TraceCache {
+	public:
+		static const unsigned int NumEntries = 1024;
+
+		TraceCache();
+		TraceCache(const TraceCache& oth);
+		TraceCache& operator=(const TraceCache& oth);
+
+		// returns false on a miss
+		bool find(const Position& from, const Position& to,
+				uint64_t mapversion, uint64_t occversion, Position& result);
+		void insert(const Position& from, const Position& to,
+				uint64_t mapversion, uint64_t occversion, const Position& result);
+
+		uint64_t getHits() const;
+		uint64_t getMisses() const;
+
+	private:
+		struct Entry {
+			Position from;
+			Position to;
+			Position result;
+			uint64_t mapversion;
+			uint64_t occversion;
+		};
+
+		static unsigned int slot(const Position& from, const Position& to);
+
+		std::vector<Entry> mEntries;
+		uint64_t mHits;
+		uint64_t mMisses;
 };
 
 class WorldData : public boost::static_visitor<bool> {
 	public:
 		WorldData();
-		WorldData(unsigned int w, unsigned int h, unsigned int nsoldiers);
+		WorldData(unsigned int w, unsigned int h, unsigned int nsoldiers, uint64_t seed);
+		// places the soldiers on the given map
+		WorldData(const MapData& map, unsigned int nsoldiers, uint64_t seed);
+		// throws std::runtime_error if the state isn't consistent
+		explicit WorldData(const WorldState& s);
 
 		static TeamID teamIDFromSoldierID(SoldierID s);
-		bool sync(WorldInterface& wi);
+		// viewer is the team asking, see SoldierQuery. Lost sightings
+		// then hide the viewer's enemies the same way.
+		bool sync(WorldInterface& wi, TeamID viewer = TeamID(0));
 
 		TeamData* getTeam(TeamID t);
 		TeamData* getTeam(SoldierID t);
 		SoldierData* getSoldier(SoldierID s);
-		MapData* getMapData();
 		SoldierData& getCurrentSoldier();
 		SoldierData* getSoldierAt(const Position& p);
 
@@ -355,13 +579,29 @@ class WorldData : public boost::static_visitor<bool> {
 		// call this function only for a team where all the soldiers are known
 		bool teamLost(TeamID tid) const;
 
-		std::set<Position> getSoldierPositions() const;
-		void syncCurrentSoldier(WorldInterface& wi);
+		// one bit per tile, set where a live soldier stands
+		const Bitset& getSoldierPositions() const;
+		// where a shot from 'from' at 'to' stops: the first blocked or
+		// occupied tile on the line, except for the shooter's and the
+		// adjacent tile, or 'to' if there's nothing in the way. Results
+		// are cached until the map or a soldier's tile changes, so
+		// concurrent calls on one WorldData aren't safe.
+		Position traceShot(const Position& from, const Position& to) const;
+		const TraceCache& getTraceCache() const;
+		// whether the line from one soldier to another is clear of
+		// blocked tiles, and whether it's also clear of other soldiers so
+		// that a shot would reach the target. Both are kept up to date as
+		// soldiers move and die, and are false for dead soldiers.
+		bool inLineOfSight(SoldierID from, SoldierID to) const;
+		bool inLineOfFire(SoldierID from, SoldierID to) const;
+		void syncCurrentSoldier(WorldInterface& wi, TeamID viewer = TeamID(0));
+		WorldState getState() const;
 
 		bool operator()(const Common::SoldierQueryResult& q);
 		bool operator()(const Common::TeamQueryResult& q);
 		bool operator()(const Common::MapQueryResult& q);
 		bool operator()(const Common::CurrentSoldierQueryResult& q);
+		bool operator()(const Common::SnapshotQueryResult& q);
 		bool operator()(const Common::DeniedQueryResult& q);
 		bool operator()(const Common::InvalidQueryResult& q);
 
@@ -381,13 +621,45 @@ class WorldData : public boost::static_visitor<bool> {
 		static unsigned int soldierIndexFromSoldierID(SoldierID s);
 
 	private:
+		// see panicfire/common/Serialization.h
+		friend class boost::serialization::access;
+		template<class Archive> void serialize(Archive& ar, const unsigned int version);
+		template<class Archive> void save(Archive& ar, const unsigned int version) const;
+		template<class Archive> void load(Archive& ar, const unsigned int version);
+
 		static Direction getDirection(const Position& from, const Position& to);
-		void generateSoldierPositions();
+		void generateSoldierPositions(Rng& rng);
+		void setState(const WorldState& s);
+		void rebuildOccupancy();
+		void occupy(unsigned int sindex);
+		void vacate(unsigned int sindex);
+		void rebuildLines();
+		// call after soldier sindex moved away from oldpos or died
+		void updateLines(unsigned int sindex, const Position& oldpos);
+		void traceLines(unsigned int from, unsigned int to);
+		// only ever replaced as a whole followed by rebuildOccupancy(),
+		// there's no mutable access so that the caches can't go stale
 		MapData mMapData;
 		std::array<TeamData, MAX_NUM_TEAMS> mTeamData;
 		std::array<SoldierData, MAX_NUM_TEAMS * MAX_TEAM_SOLDIERS> mSoldierData;
 		TeamID mCurrentTeamID;
 		std::array<unsigned int, MAX_NUM_TEAMS> mCurrentSoldierIDIndex;
+		// the team this copy was synced for, 0 for all teams
+		TeamID mViewer;
+
+		// occupancy index kept up to date by the event handlers:
+		// soldier index + 1 per tile (0 if free) and the matching bitmap
+		std::vector<unsigned short> mOccupant;
+		Bitset mOccupied;
+		// soldier by soldier matrices, indexed by from * soldiers + to
+		Bitset mLineOfSight;
+		Bitset mLineOfFire;
+
+		// bumped whenever the map or a soldier's tile changes, zero is
+		// never used so that empty cache entries never match
+		uint64_t mMapVersion = 1;
+		uint64_t mOccupancyVersion = 1;
+		mutable TraceCache mTraceCache;
 };
 
 }
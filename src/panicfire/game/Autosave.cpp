@@ -0,0 +1,73 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "panicfire/common/Checkpoint.h"
+#include "panicfire/game/Autosave.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+Autosave::Autosave(const std::string& path, unsigned int interval)
+	: mPath(path),
+	mInterval(interval ? interval : 1),
+	mTurns(0),
+	mStop(false)
+{
+	mThread = std::thread(&Autosave::run, this);
+}
+
+Autosave::~Autosave()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mCond.notify_one();
+	mThread.join();
+}
+
+void Autosave::save(const Common::WorldData& d)
+{
+	std::unique_ptr<Common::WorldState> copy(new Common::WorldState(d.getState()));
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending.swap(copy);
+	}
+	mCond.notify_one();
+	// an older unsaved state, if any, is freed here outside the lock
+}
+
+void Autosave::turnFinished(const Common::WorldData& d)
+{
+	mTurns++;
+	if(mTurns % mInterval == 0)
+		save(d);
+}
+
+void Autosave::run()
+{
+	while(1) {
+		std::unique_ptr<Common::WorldState> d;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCond.wait(lock, [this]() { return mStop || mPending; });
+			if(!mPending)
+				return;
+			// write the last state even when stopping
+			d.swap(mPending);
+		}
+
+		try {
+			Common::saveCheckpoint(mPath, *d);
+		}
+		catch(std::exception& e) {
+			std::cerr << "Autosave failed: " << e.what() << "\n";
+		}
+	}
+}
+
+}
+
+}
+
@@ -0,0 +1,51 @@
+#ifndef PANICFIRE_GAME_AUTOSAVE_H
+#define PANICFIRE_GAME_AUTOSAVE_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+// Writes checkpoints on a background thread. The caller only copies the
+// saved state (the map layers are shared, not copied, and the derived
+// occupancy and line data are left out); compression and file I/O
+// happen on the autosave thread. If a new state arrives while the
+// previous one is still being written, only the newest one is kept.
+class Autosave {
+	public:
+		// saves every interval turns
+		Autosave(const std::string& path, unsigned int interval = 1);
+		~Autosave();
+		Autosave(const Autosave&) = delete;
+		Autosave& operator=(const Autosave&) = delete;
+
+		void save(const Common::WorldData& d);
+		void turnFinished(const Common::WorldData& d);
+
+	private:
+		void run();
+
+		std::string mPath;
+		unsigned int mInterval;
+		unsigned int mTurns;
+
+		std::mutex mMutex;
+		std::condition_variable mCond;
+		std::unique_ptr<Common::WorldState> mPending;
+		bool mStop;
+		std::thread mThread;
+};
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,133 @@
+#include <stdexcept>
+
+#include "panicfire/game/EventLog.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+static const uint64_t RemovedReader = UINT64_MAX;
+// a reader handle is its slot in the low bits and the slot's generation
+// in the high bits
+static const unsigned int SlotBits = 16;
+static const unsigned int SlotMask = (1u << SlotBits) - 1;
+
+EventLog::EventLog()
+	: mEvents(1024),
+	mFirstSeq(0)
+{
+}
+
+unsigned int EventLog::addReader(unsigned int teams)
+{
+	// new readers only see events appended after they joined
+	uint64_t cursor = mFirstSeq + mEvents.size();
+	// reuse the slot of a removed reader so that the cursors don't
+	// pile up as spectators come and go
+	unsigned int i = 0;
+	while(i < mCursors.size() && mCursors[i] != RemovedReader)
+		i++;
+	if(i == mCursors.size()) {
+		if(i > SlotMask)
+			throw std::runtime_error("EventLog: too many readers");
+		mCursors.push_back(cursor);
+		mTeams.push_back(teams);
+		mGenerations.push_back(0);
+	} else {
+		mCursors[i] = cursor;
+		mTeams[i] = teams;
+	}
+	return i | (mGenerations[i] << SlotBits);
+}
+
+void EventLog::removeReader(unsigned int reader)
+{
+	unsigned int i = slot(reader);
+	mCursors[i] = RemovedReader;
+	mGenerations[i] = (mGenerations[i] + 1) & (~0u >> SlotBits);
+	truncate();
+}
+
+bool EventLog::validReader(unsigned int reader) const
+{
+	unsigned int i = reader & SlotMask;
+	return i < mCursors.size() && mCursors[i] != RemovedReader &&
+		mGenerations[i] == reader >> SlotBits;
+}
+
+unsigned int EventLog::slot(unsigned int reader) const
+{
+	if(!validReader(reader))
+		throw std::runtime_error("EventLog: invalid reader");
+	return reader & SlotMask;
+}
+
+void EventLog::append(const Common::Event& ev, unsigned int teams)
+{
+	mEvents.push_back(Entry{ev, teams});
+}
+
+unsigned int EventLog::pending(unsigned int reader) const
+{
+	unsigned int r = slot(reader);
+	unsigned int teams = mTeams[r];
+	unsigned int num = 0;
+	for(uint64_t i = mCursors[r] - mFirstSeq; i < mEvents.size(); i++) {
+		if(mEvents[i].teams & teams)
+			num++;
+	}
+	return num;
+}
+
+bool EventLog::read(unsigned int reader, Common::Event& ev)
+{
+	unsigned int r = slot(reader);
+	unsigned int teams = mTeams[r];
+	uint64_t end = mFirstSeq + mEvents.size();
+	bool found = false;
+	while(!found && mCursors[r] < end) {
+		const Entry& e = mEvents[mCursors[r] - mFirstSeq];
+		if(e.teams & teams) {
+			ev = e.event;
+			found = true;
+		}
+		mCursors[r]++;
+	}
+	truncate();
+	return found;
+}
+
+unsigned int EventLog::drain(unsigned int reader, std::vector<Common::Event>& out)
+{
+	unsigned int r = slot(reader);
+	unsigned int teams = mTeams[r];
+	unsigned int num = 0;
+	for(uint64_t i = mCursors[r] - mFirstSeq; i < mEvents.size(); i++) {
+		const Entry& e = mEvents[i];
+		if(e.teams & teams) {
+			out.push_back(e.event);
+			num++;
+		}
+	}
+	mCursors[r] = mFirstSeq + mEvents.size();
+	truncate();
+	return num;
+}
+
+void EventLog::truncate()
+{
+	uint64_t slowest = mFirstSeq + mEvents.size();
+	for(auto c : mCursors) {
+		if(c < slowest)
+			slowest = c;
+	}
+	while(mFirstSeq < slowest) {
+		mEvents.pop_front();
+		mFirstSeq++;
+	}
+}
+
+}
+
+}
+
@@ -0,0 +1,65 @@
+#ifndef PANICFIRE_GAME_EVENTLOG_H
+#define PANICFIRE_GAME_EVENTLOG_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/common/RingBuffer.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+// Append-only event log shared by all readers. Each event is stored
+// once; every reader has a cursor (the sequence number of the next
+// event it will read) and events are dropped from the log once all
+// cursors have passed them.
+//
+// Events and readers carry a mask with a bit per team index. A reader
+// only gets the events whose mask shares a bit with its own; the other
+// events are skipped over.
+//
+// Readers are handles holding a slot and its generation. Removed slots
+// are reused with the next generation, so an old handle never reaches
+// a newer reader: using it throws std::runtime_error.
+class EventLog {
+	public:
+		static const unsigned int AllTeams = ~0u;
+
+		EventLog();
+		unsigned int addReader(unsigned int teams = AllTeams);
+		// a removed reader no longer holds back truncation
+		void removeReader(unsigned int reader);
+		bool validReader(unsigned int reader) const;
+		void append(const Common::Event& ev, unsigned int teams = AllTeams);
+		// the number of events for the reader
+		unsigned int pending(unsigned int reader) const;
+		// returns false if the reader has no pending events
+		bool read(unsigned int reader, Common::Event& ev);
+		// appends all pending events to out, returns their number
+		unsigned int drain(unsigned int reader, std::vector<Common::Event>& out);
+
+	private:
+		unsigned int slot(unsigned int reader) const;
+		void truncate();
+
+		struct Entry {
+			Common::Event event;
+			unsigned int teams;
+		};
+
+		Common::RingBuffer<Entry> mEvents;
+		uint64_t mFirstSeq; // sequence number of mEvents.front()
+		std::vector<uint64_t> mCursors;
+		std::vector<unsigned int> mTeams;
+		std::vector<unsigned int> mGenerations;
+};
+
+}
+
+}
+
+#endif
+
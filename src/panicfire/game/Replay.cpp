@@ -0,0 +1,455 @@
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/archive/archive_exception.hpp>
+
+#include "panicfire/common/Serialization.h"
+#include "panicfire/game/World.h"
+#include "panicfire/game/Replay.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+using namespace PanicFire::Common;
+
+static const uint32_t ReplayMagic = 0x50524650; // "PFRP"
+static const uint32_t IndexMagic = 0x58524650; // "PFRX"
+static const uint32_t ReplayVersion = 3;
+
+// size of the offsets and magic at the very end of the file
+static const unsigned int TrailerSize = 8 + 8 + 4;
+
+static const boost::archive::archive_flags ArchiveFlags =
+	boost::archive::archive_flags(boost::archive::no_header | boost::archive::no_codecvt);
+
+enum class Record : uint8_t {
+	Movement,
+	Shot,
+	FinishTurn,
+	Keyframe,
+	End
+};
+
+// writes an input record
+class InputWriter : public boost::static_visitor<> {
+	public:
+		InputWriter(boost::archive::binary_oarchive& ar) : mArchive(ar) { }
+
+		void operator()(const MovementInput& i)
+		{
+			tag(Record::Movement);
+			soldier(i.mover);
+			position(i.from);
+			position(i.to);
+		}
+
+		void operator()(const ShotInput& i)
+		{
+			tag(Record::Shot);
+			soldier(i.shooter);
+			position(i.target);
+		}
+
+		void operator()(const FinishTurnInput& i)
+		{
+			tag(Record::FinishTurn);
+		}
+
+	private:
+		void tag(Record r)
+		{
+			mArchive << static_cast<uint8_t>(r);
+		}
+
+		void soldier(SoldierID s)
+		{
+			assert(s.id <= 0xff);
+			mArchive << static_cast<uint8_t>(s.id);
+		}
+
+		void position(const Position& p)
+		{
+			if(p.x > 0xffff || p.y > 0xffff)
+				throw std::runtime_error("Replay: position doesn't fit in a record");
+			mArchive << static_cast<uint16_t>(p.x);
+			mArchive << static_cast<uint16_t>(p.y);
+		}
+
+		boost::archive::binary_oarchive& mArchive;
+};
+
+// ReplayWriter
+ReplayWriter::ReplayWriter(const std::string& path, uint64_t seed,
+		const WorldData& initial,
+		unsigned int keyframeinterval)
+	: mFile(path.c_str(), std::ios::binary | std::ios::trunc),
+	mKeyframeInterval(keyframeinterval ? keyframeinterval : 1),
+	mTurn(0),
+	mInputs(0),
+	mFinished(false)
+{
+	if(!mFile)
+		throw std::runtime_error("Replay: could not open " + path + " for writing");
+	mArchive.reset(new boost::archive::binary_oarchive(mFile, ArchiveFlags));
+	*mArchive << ReplayMagic;
+	*mArchive << ReplayVersion;
+	*mArchive << seed;
+	*mArchive << *initial.getMapData();
+	writeKeyframe(initial);
+}
+
+ReplayWriter::~ReplayWriter()
+{
+	try {
+		finish(TeamID(0));
+	}
+	catch(std::exception& e) {
+		std::cerr << "Replay: could not finish: " << e.what() << "\n";
+	}
+}
+
+void ReplayWriter::input(const Input& i, const WorldData& after)
+{
+	assert(!mFinished);
+	InputWriter iw(*mArchive);
+	boost::apply_visitor(iw, i);
+	mInputs++;
+	if(boost::get<FinishTurnInput>(&i)) {
+		mTurn++;
+		if(mTurn % mKeyframeInterval == 0)
+			writeKeyframe(after);
+	}
+}
+
+void ReplayWriter::finish(TeamID winner)
+{
+	if(mFinished)
+		return;
+	mFinished = true;
+
+	uint64_t endoffset = mFile.tellp();
+	*mArchive << static_cast<uint8_t>(Record::End);
+	*mArchive << winner;
+	*mArchive << mTurn;
+	*mArchive << mInputs;
+
+	uint64_t indexoffset = mFile.tellp();
+	*mArchive << static_cast<uint32_t>(mKeyframes.size());
+	for(auto& k : mKeyframes) {
+		*mArchive << k.turn;
+		*mArchive << k.input;
+		*mArchive << k.offset;
+	}
+	*mArchive << endoffset;
+	*mArchive << indexoffset;
+	*mArchive << IndexMagic;
+	mFile.flush();
+	if(!mFile)
+		throw std::runtime_error("Replay: write failed");
+}
+
+void ReplayWriter::writeKeyframe(const WorldData& d)
+{
+	ReplayKeyframe k;
+	k.turn = mTurn;
+	k.input = mInputs;
+	k.offset = mFile.tellp();
+	mKeyframes.push_back(k);
+
+	// the state goes through a buffer to learn its length
+	WorldState s = d.getState();
+	std::ostringstream buf;
+	{
+		boost::archive::binary_oarchive ar(buf, ArchiveFlags);
+		for(auto& t : s.teams)
+			ar << t;
+		for(auto& sd : s.soldiers)
+			ar << sd;
+		ar << s.currentteam;
+		for(auto i : s.currentsoldierindex)
+			ar << i;
+	}
+	const std::string state = buf.str();
+
+	*mArchive << static_cast<uint8_t>(Record::Keyframe);
+	*mArchive << k.turn;
+	*mArchive << k.input;
+	*mArchive << static_cast<uint32_t>(state.size());
+	mArchive->save_binary(state.data(), state.size());
+}
+
+// ReplayReader
+ReplayReader::ReplayReader(const std::string& path)
+	: mFile(path.c_str(), std::ios::binary),
+	mSeed(0),
+	mComplete(false),
+	mWinner(0),
+	mNumTurns(0),
+	mNumInputs(0),
+	mFirstRecord(0),
+	mTurn(0)
+{
+	if(!mFile)
+		throw std::runtime_error("Replay: could not open " + path);
+	mArchive.reset(new boost::archive::binary_iarchive(mFile, ArchiveFlags));
+
+	uint32_t magic, version;
+	*mArchive >> magic;
+	*mArchive >> version;
+	if(magic != ReplayMagic)
+		throw std::runtime_error("Replay: " + path + " is not a replay file");
+	if(version != ReplayVersion)
+		throw std::runtime_error("Replay: unsupported version");
+	*mArchive >> mSeed;
+	*mArchive >> mMap;
+	mFirstRecord = mFile.tellg();
+
+	if(!readIndex())
+		scan();
+	if(mKeyframes.empty())
+		throw std::runtime_error("Replay: no keyframes in " + path);
+	seekOffset(mKeyframes[0].offset);
+}
+
+uint64_t ReplayReader::getSeed() const
+{
+	return mSeed;
+}
+
+bool ReplayReader::isComplete() const
+{
+	return mComplete;
+}
+
+TeamID ReplayReader::getWinner() const
+{
+	return mWinner;
+}
+
+uint32_t ReplayReader::getNumTurns() const
+{
+	return mNumTurns;
+}
+
+uint64_t ReplayReader::getNumInputs() const
+{
+	return mNumInputs;
+}
+
+const std::vector<ReplayKeyframe>& ReplayReader::getKeyframes() const
+{
+	return mKeyframes;
+}
+
+uint32_t ReplayReader::getTurn() const
+{
+	return mTurn;
+}
+
+uint32_t ReplayReader::seek(World& w, uint32_t turn)
+{
+	auto it = mKeyframes.begin();
+	for(auto kit = mKeyframes.begin(); kit != mKeyframes.end() && kit->turn <= turn; ++kit)
+		it = kit;
+
+	seekOffset(it->offset);
+	if(readTag() != static_cast<uint8_t>(Record::Keyframe))
+		throw std::runtime_error("Replay: corrupt keyframe index");
+	uint64_t input;
+	WorldState s;
+	readState(readKeyframeHeader(mTurn, input), s);
+	w.restore(WorldData(s));
+
+	Input i = FinishTurnInput();
+	while(mTurn < turn && next(i)) {
+		if(!w.input(i))
+			throw std::runtime_error("Replay: input denied, replay out of sync");
+	}
+	return mTurn;
+}
+
+bool ReplayReader::next(Input& i)
+{
+	try {
+		while(1) {
+			uint8_t tag = readTag();
+			if(tag == static_cast<uint8_t>(Record::Keyframe)) {
+				uint32_t turn;
+				uint64_t input;
+				skip(readKeyframeHeader(turn, input));
+				continue;
+			}
+			if(tag == static_cast<uint8_t>(Record::End))
+				return false;
+			readInput(tag, i);
+			if(boost::get<FinishTurnInput>(&i))
+				mTurn++;
+			return true;
+		}
+	}
+	catch(boost::archive::archive_exception& e) {
+		// recording was cut off
+		return false;
+	}
+}
+
+void ReplayReader::seekOffset(uint64_t offset)
+{
+	mFile.clear();
+	mFile.seekg(offset);
+	mArchive.reset(new boost::archive::binary_iarchive(mFile, ArchiveFlags));
+}
+
+bool ReplayReader::readIndex()
+{
+	mFile.seekg(0, std::ios::end);
+	uint64_t size = mFile.tellg();
+	if(size < mFirstRecord + TrailerSize)
+		return false;
+
+	try {
+		uint64_t endoffset, indexoffset;
+		uint32_t magic;
+		seekOffset(size - TrailerSize);
+		*mArchive >> endoffset;
+		*mArchive >> indexoffset;
+		*mArchive >> magic;
+		if(magic != IndexMagic || endoffset >= indexoffset || indexoffset >= size)
+			return false;
+
+		seekOffset(endoffset);
+		if(readTag() != static_cast<uint8_t>(Record::End))
+			return false;
+		readEnd();
+
+		seekOffset(indexoffset);
+		uint32_t num;
+		*mArchive >> num;
+		mKeyframes.resize(num);
+		for(auto& k : mKeyframes) {
+			*mArchive >> k.turn;
+			*mArchive >> k.input;
+			*mArchive >> k.offset;
+		}
+	}
+	catch(boost::archive::archive_exception& e) {
+		mKeyframes.clear();
+		mComplete = false;
+		return false;
+	}
+	return true;
+}
+
+void ReplayReader::scan()
+{
+	std::cerr << "Replay: no index found, scanning.\n";
+	mKeyframes.clear();
+	mNumTurns = 0;
+	mNumInputs = 0;
+	seekOffset(mFirstRecord);
+	try {
+		while(1) {
+			uint64_t offset = mFile.tellg();
+			uint8_t tag = readTag();
+			if(tag == static_cast<uint8_t>(Record::Keyframe)) {
+				ReplayKeyframe k;
+				skip(readKeyframeHeader(k.turn, k.input));
+				k.offset = offset;
+				mKeyframes.push_back(k);
+			} else if(tag == static_cast<uint8_t>(Record::End)) {
+				readEnd();
+				break;
+			} else {
+				Input i = FinishTurnInput();
+				readInput(tag, i);
+				mNumInputs++;
+				if(boost::get<FinishTurnInput>(&i))
+					mNumTurns++;
+			}
+		}
+	}
+	catch(boost::archive::archive_exception& e) {
+		// recording was cut off - keep what we have
+	}
+}
+
+uint8_t ReplayReader::readTag()
+{
+	uint8_t tag;
+	*mArchive >> tag;
+	return tag;
+}
+
+uint32_t ReplayReader::readKeyframeHeader(uint32_t& turn, uint64_t& input)
+{
+	uint32_t size;
+	*mArchive >> turn;
+	*mArchive >> input;
+	*mArchive >> size;
+	return size;
+}
+
+void ReplayReader::readState(uint32_t size, WorldState& s)
+{
+	uint64_t end = uint64_t(mFile.tellg()) + size;
+	s.map = mMap;
+	for(auto& t : s.teams)
+		*mArchive >> t;
+	for(auto& sd : s.soldiers)
+		*mArchive >> sd;
+	*mArchive >> s.currentteam;
+	for(auto& i : s.currentsoldierindex)
+		*mArchive >> i;
+	if(uint64_t(mFile.tellg()) != end)
+		throw std::runtime_error("Replay: corrupt keyframe");
+}
+
+void ReplayReader::skip(uint32_t size)
+{
+	uint64_t end = uint64_t(mFile.tellg()) + size;
+	mFile.seekg(0, std::ios::end);
+	uint64_t filesize = mFile.tellg();
+	// a keyframe that was cut off ends the recording like a cut off
+	// input record does
+	if(end > filesize)
+		throw boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error);
+	seekOffset(end);
+}
+
+void ReplayReader::readEnd()
+{
+	*mArchive >> mWinner;
+	*mArchive >> mNumTurns;
+	*mArchive >> mNumInputs;
+	mComplete = true;
+}
+
+void ReplayReader::readInput(uint8_t tag, Input& i)
+{
+	uint8_t s;
+	uint16_t x1, y1, x2, y2;
+	switch(static_cast<Record>(tag)) {
+		case Record::Movement:
+			*mArchive >> s >> x1 >> y1 >> x2 >> y2;
+			i = MovementInput(SoldierID(s), Position(x1, y1), Position(x2, y2));
+			return;
+
+		case Record::Shot:
+			*mArchive >> s >> x1 >> y1;
+			i = ShotInput(SoldierID(s), Position(x1, y1));
+			return;
+
+		case Record::FinishTurn:
+			i = FinishTurnInput();
+			return;
+
+		default:
+			throw std::runtime_error("Replay: corrupt record");
+	}
+}
+
+}
+
+}
+
@@ -0,0 +1,129 @@
+#ifndef PANICFIRE_GAME_REPLAY_H
+#define PANICFIRE_GAME_REPLAY_H
+
+#include <stdint.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+class World;
+
+// Replay file layout, written front to back as a stream:
+//
+//   header    magic, version, seed, the map
+//   records   one tag byte each, followed by
+//             - the input fields (at most 9 bytes), or
+//             - a keyframe: turn, input count, the byte length of the
+//               rest and the world state without the map, which can't
+//               change during a match
+//   end       tag, winner, number of turns and inputs
+//   index     turn, input count and file offset of each keyframe,
+//             then the offsets of the end record and the index and
+//             another magic
+//
+// The first record is a keyframe of the initial state and then one is
+// written every keyframeinterval turns. Readers skip over the keyframes
+// they don't restore from without decoding them. A file without the
+// trailing index (e.g. from a crashed process) can still be read; the
+// index is then rebuilt by scanning the records.
+
+struct ReplayKeyframe {
+	uint32_t turn;
+	uint64_t input; // number of inputs before the keyframe
+	uint64_t offset;
+};
+
+class ReplayWriter {
+	public:
+		ReplayWriter(const std::string& path, uint64_t seed,
+				const Common::WorldData& initial,
+				unsigned int keyframeinterval = 64);
+		~ReplayWriter();
+		ReplayWriter(const ReplayWriter&) = delete;
+		ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+		// called by World for each accepted input, with the state
+		// after the input was applied
+		void input(const Common::Input& i, const Common::WorldData& after);
+		// writes the end record and the index; the destructor does
+		// this with no winner if it hasn't been called
+		void finish(Common::TeamID winner);
+
+	private:
+		void writeKeyframe(const Common::WorldData& d);
+
+		std::ofstream mFile;
+		std::unique_ptr<boost::archive::binary_oarchive> mArchive;
+		unsigned int mKeyframeInterval;
+		uint32_t mTurn;
+		uint64_t mInputs;
+		std::vector<ReplayKeyframe> mKeyframes;
+		bool mFinished;
+};
+
+class ReplayReader {
+	public:
+		ReplayReader(const std::string& path);
+		ReplayReader(const ReplayReader&) = delete;
+		ReplayReader& operator=(const ReplayReader&) = delete;
+
+		uint64_t getSeed() const;
+		// false if the recording stopped without an end record
+		bool isComplete() const;
+		Common::TeamID getWinner() const;
+		uint32_t getNumTurns() const;
+		uint64_t getNumInputs() const;
+		const std::vector<ReplayKeyframe>& getKeyframes() const;
+
+		// Restores w to the state at the start of the given turn
+		// using the nearest keyframe before it and replaying the rest.
+		// Reading continues from there. Returns the turn reached,
+		// which is less than the one requested if the replay ends
+		// before it.
+		uint32_t seek(World& w, uint32_t turn);
+		// returns false at the end of the replay
+		bool next(Common::Input& i);
+		uint32_t getTurn() const;
+
+	private:
+		void seekOffset(uint64_t offset);
+		bool readIndex();
+		void scan();
+		uint8_t readTag();
+		// reads the keyframe up to its state, returning the state's size
+		uint32_t readKeyframeHeader(uint32_t& turn, uint64_t& input);
+		void readState(uint32_t size, Common::WorldState& s);
+		void skip(uint32_t size);
+		void readEnd();
+		void readInput(uint8_t tag, Common::Input& i);
+
+		std::ifstream mFile;
+		std::unique_ptr<boost::archive::binary_iarchive> mArchive;
+		uint64_t mSeed;
+		Common::MapData mMap;
+		bool mComplete;
+		Common::TeamID mWinner;
+		uint32_t mNumTurns;
+		uint64_t mNumInputs;
+		uint64_t mFirstRecord;
+		std::vector<ReplayKeyframe> mKeyframes;
+		uint32_t mTurn;
+};
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,143 @@
+#include <algorithm>
+
+#include "panicfire/game/Vision.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+using namespace PanicFire::Common;
+
+const unsigned int Vision::NumSoldiers;
+
+Vision::Vision(unsigned int radius)
+	: mRadius(radius),
+	mWidth(0)
+{
+	for(auto& t : mSeen)
+		t.fill(false);
+}
+
+void Vision::reset(const WorldData& d, std::vector<SightingEvent>& events)
+{
+	const MapData* m = d.getMapData();
+	mWidth = m->getWidth();
+	for(auto& c : mCount)
+		c.assign(m->getWidth() * m->getHeight(), 0);
+	for(auto& v : mVisible)
+		v.resize(m->getWidth() * m->getHeight());
+	for(auto& t : mSeen)
+		t.fill(false);
+
+	for(unsigned int i = 0; i < NumSoldiers; i++) {
+		computeFOV(d, i);
+		auto sd = d.getSoldier(SoldierID(i + 1));
+		if(sd && sd->id.id)
+			addFOV(WorldData::teamIndexFromTeamID(sd->teamid), mFOV[i], true);
+	}
+
+	findSightings(d, SoldierID(0), events);
+}
+
+void Vision::update(const WorldData& d, SoldierID s, std::vector<SightingEvent>& events)
+{
+	unsigned int sindex = WorldData::soldierIndexFromSoldierID(s);
+	auto sd = d.getSoldier(s);
+	if(!sd || !sd->id.id || sindex >= NumSoldiers)
+		return;
+
+	unsigned int tindex = WorldData::teamIndexFromTeamID(sd->teamid);
+	std::swap(mOldFOV, mFOV[sindex]);
+	computeFOV(d, sindex);
+	addFOV(tindex, mOldFOV, false);
+	addFOV(tindex, mFOV[sindex], true);
+
+	findSightings(d, s, events);
+}
+
+const Bitset& Vision::getVisibleTiles(TeamID t) const
+{
+	return mVisible.at(WorldData::teamIndexFromTeamID(t));
+}
+
+bool Vision::sees(TeamID t, SoldierID s) const
+{
+	return mSeen.at(WorldData::teamIndexFromTeamID(t)).at(WorldData::soldierIndexFromSoldierID(s));
+}
+
+void Vision::computeFOV(const WorldData& d, unsigned int sindex)
+{
+	auto sd = d.getSoldier(SoldierID(sindex + 1));
+	if(sd && sd->id.id && sd->alive() && d.getMapData()->inside(sd->position))
+		mFOV[sindex].compute(*d.getMapData(), sd->position, mRadius);
+	else
+		mFOV[sindex].clear();
+}
+
+void Vision::addFOV(unsigned int tindex, const FieldOfView& fov, bool add)
+{
+	std::vector<unsigned char>& count = mCount[tindex];
+	Bitset& visible = mVisible[tindex];
+	for(unsigned int y = fov.getY0(); y < fov.getY1(); y++) {
+		for(unsigned int x = fov.getX0(); x < fov.getX1(); x++) {
+			if(!fov.visible(Position(x, y)))
+				continue;
+			unsigned int i = y * mWidth + x;
+			if(add) {
+				if(count[i]++ == 0)
+					visible.set(i);
+			} else {
+				if(--count[i] == 0)
+					visible.reset(i);
+			}
+		}
+	}
+}
+
+// compares what each team sees with what it saw before. Soldiers that
+// died just drop out of sight without an event.
+void Vision::findSightings(const WorldData& d, SoldierID changed,
+		std::vector<SightingEvent>& events)
+{
+	const MapData* m = d.getMapData();
+	for(unsigned int t = 0; t < MAX_NUM_TEAMS; t++) {
+		TeamID tid(t + 1);
+		for(unsigned int j = 0; j < NumSoldiers; j++) {
+			auto sd = d.getSoldier(SoldierID(j + 1));
+			if(!sd || !sd->id.id)
+				continue;
+			bool alive = sd->alive() && m->inside(sd->position);
+			bool now = alive && (sd->teamid == tid ||
+					mVisible[t].test(m->tileIndex(sd->position)));
+			if(now == mSeen[t][j])
+				continue;
+			mSeen[t][j] = now;
+			if(!alive || sd->teamid == tid)
+				continue;
+
+			SoldierID seer;
+			if(now) {
+				for(unsigned int k = 0; k < NumSoldiers; k++) {
+					auto sd2 = d.getSoldier(SoldierID(k + 1));
+					if(sd2 && sd2->teamid == tid && mFOV[k].visible(sd->position)) {
+						seer = sd2->id;
+						break;
+					}
+				}
+			} else if(changed.id && WorldData::teamIDFromSoldierID(changed) == tid) {
+				seer = changed;
+			} else {
+				auto td = d.getTeam(tid);
+				if(td)
+					seer = td->soldiers[0];
+			}
+			events.push_back(SightingEvent(seer, sd->id, now,
+						now ? sd->position : Position()));
+		}
+	}
+}
+
+}
+
+}
+
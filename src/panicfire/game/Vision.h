@@ -0,0 +1,59 @@
+#ifndef PANICFIRE_GAME_VISION_H
+#define PANICFIRE_GAME_VISION_H
+
+#include <array>
+#include <vector>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/common/FieldOfView.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+// What each team sees: the field of view of every live soldier and,
+// per team, a bit per tile seen by any of its soldiers. Only the
+// fields of view of soldiers that moved or died are recomputed. Each
+// team also counts how many of its soldiers see each tile, so a
+// changed field of view is applied by taking out the old one and
+// adding the new one.
+class Vision {
+	public:
+		Vision(unsigned int radius = SIGHT_RADIUS);
+
+		// recomputes everything and reports every soldier in sight of
+		// the other team
+		void reset(const Common::WorldData& d, std::vector<Common::SightingEvent>& events);
+		// call after soldier s moved or died; reports the soldiers that
+		// came into or went out of sight of a team
+		void update(const Common::WorldData& d, Common::SoldierID s,
+				std::vector<Common::SightingEvent>& events);
+
+		// one bit per tile, indexed like the map
+		const Common::Bitset& getVisibleTiles(Common::TeamID t) const;
+		bool sees(Common::TeamID t, Common::SoldierID s) const;
+
+	private:
+		void computeFOV(const Common::WorldData& d, unsigned int sindex);
+		void addFOV(unsigned int tindex, const Common::FieldOfView& fov, bool add);
+		void findSightings(const Common::WorldData& d, Common::SoldierID changed,
+				std::vector<Common::SightingEvent>& events);
+
+		static const unsigned int NumSoldiers = MAX_NUM_TEAMS * MAX_TEAM_SOLDIERS;
+
+		unsigned int mRadius;
+		std::array<Common::FieldOfView, NumSoldiers> mFOV;
+		Common::FieldOfView mOldFOV;
+		std::array<std::vector<unsigned char>, MAX_NUM_TEAMS> mCount;
+		std::array<Common::Bitset, MAX_NUM_TEAMS> mVisible;
+		unsigned int mWidth;
+		// whether each soldier is in sight of each team
+		std::array<std::array<bool, NumSoldiers>, MAX_NUM_TEAMS> mSeen;
+};
+
+}
+
+}
+
+#endif
+
@@ -1,8 +1,9 @@
 #include <iostream>
-
-#include "common/Line.h"
+#include <stdexcept>
 
 #include "panicfire/game/World.h"
+#include "panicfire/game/Replay.h"
+#include "panicfire/game/Autosave.h"
 
 namespace PanicFire { 
 
@@ -10,9 +11,26 @@ namespace Game {
 
 using namespace PanicFire::Common;
 
-World::World()
+World::World(uint64_t seed)
+	: mWinner(0),
+	mReplay(nullptr),
+	mAutosave(nullptr)
 {
-	mData = new WorldData(24, 24, MAX_TEAM_SOLDIERS);
+	mData = new WorldData(24, 24, MAX_TEAM_SOLDIERS, seed);
+	for(unsigned int t = 0; t < MAX_NUM_TEAMS; t++)
+		mTeamReader[t] = mEventLog.addReader(teamMask(TeamID(t + 1)));
+	updateVision(SoldierID(0));
+}
+
+World::World(const Common::MapData& map, uint64_t seed)
+	: mWinner(0),
+	mReplay(nullptr),
+	mAutosave(nullptr)
+{
+	mData = new WorldData(map, MAX_TEAM_SOLDIERS, seed);
+	for(unsigned int t = 0; t < MAX_NUM_TEAMS; t++)
+		mTeamReader[t] = mEventLog.addReader(teamMask(TeamID(t + 1)));
+	updateVision(SoldierID(0));
 }
 
 World::~World()
@@ -31,21 +49,132 @@ bool World::input(const Common::Input& i)
 	// so convert query result to bool.
 	// invalid => true, denied => false.
 	auto qr = boost::apply_visitor(*this, i);
-	return boost::get<DeniedQueryResult>(&qr) == 0;
+	bool accepted = boost::get<DeniedQueryResult>(&qr) == 0;
+	if(accepted && mReplay)
+		mReplay->input(i, *mData);
+	return accepted;
 }
 
 Common::Event World::pollEvents(TeamID tid)
 {
 	/* TODO: check client */
 	auto tindex = mData->teamIndexFromTeamID(tid);
-	auto& q = mEventQueue[tindex];
-	if(q.empty()) {
-		return EmptyEvent();
-	} else {
-		auto ev = q.front();
-		q.pop();
-		return ev;
+	Common::Event ev = EmptyEvent();
+	if(tindex < mTeamReader.size())
+		mEventLog.read(mTeamReader[tindex], ev);
+	return ev;
+}
+
+unsigned int World::pollEvents(TeamID tid, std::vector<Common::Event>& out)
+{
+	/* TODO: check client */
+	auto tindex = mData->teamIndexFromTeamID(tid);
+	if(tindex >= mTeamReader.size())
+		return 0;
+	return mEventLog.drain(mTeamReader[tindex], out);
+}
+
+unsigned int World::addSpectator()
+{
+	return mEventLog.addReader();
+}
+
+void World::removeSpectator(unsigned int spectator)
+{
+	checkSpectator(spectator);
+	mEventLog.removeReader(spectator);
+}
+
+unsigned int World::pollSpectatorEvents(unsigned int spectator, std::vector<Common::Event>& out)
+{
+	checkSpectator(spectator);
+	return mEventLog.drain(spectator, out);
+}
+
+void World::checkSpectator(unsigned int spectator) const
+{
+	// the teams' readers would leak their events or lose their cursor
+	for(auto r : mTeamReader) {
+		if(r == spectator)
+			throw std::runtime_error("World: not a spectator");
+	}
+	if(!mEventLog.validReader(spectator))
+		throw std::runtime_error("World: invalid spectator");
+}
+
+Common::TeamID World::getWinner() const
+{
+	return mWinner;
+}
+
+void World::setReplayWriter(ReplayWriter* r)
+{
+	mReplay = r;
+}
+
+void World::setAutosave(Autosave* a)
+{
+	mAutosave = a;
+}
+
+const Common::WorldData& World::getData() const
+{
+	return *mData;
+}
+
+void World::restore(const Common::WorldData& d)
+{
+	*mData = d;
+	mWinner = TeamID(0);
+	static_assert(MAX_NUM_TEAMS == 2, "currently only two teams are supported");
+	if(mData->teamLost(TeamID(1)))
+		mWinner = TeamID(2);
+	else if(mData->teamLost(TeamID(2)))
+		mWinner = TeamID(1);
+	updateVision(SoldierID(0));
+}
+
+const Vision& World::getVision() const
+{
+	return mVision;
+}
+
+void World::updateVision(SoldierID s)
+{
+	mSightings.clear();
+	if(s.id)
+		mVision.update(*mData, s, mSightings);
+	else
+		mVision.reset(*mData, mSightings);
+	// only the seer's team learns about a sighting
+	for(auto& ev : mSightings)
+		mEventLog.append(ev, teamMask(WorldData::teamIDFromSoldierID(ev.seer)));
+}
+
+unsigned int World::teamMask(TeamID t)
+{
+	return 1u << WorldData::teamIndexFromTeamID(t);
+}
+
+unsigned int World::seenBy(const Position& p) const
+{
+	const MapData* m = mData->getMapData();
+	if(!m->inside(p))
+		return 0;
+	unsigned int i = m->tileIndex(p);
+	unsigned int mask = 0;
+	for(unsigned int t = 0; t < MAX_NUM_TEAMS; t++) {
+		if(mVision.getVisibleTiles(TeamID(t + 1)).test(i))
+			mask |= 1u << t;
 	}
+	return mask;
+}
+
+void World::hide(SoldierData& sd, TeamID viewer) const
+{
+	if(!viewer.id || !sd.id.id || sd.teamid == viewer || mVision.sees(viewer, sd.id))
+		return;
+	sd.position = Position(~0u, ~0u);
 }
 
 Common::QueryResult World::operator()(const Common::SoldierQuery& q)
@@ -56,6 +185,7 @@ Common::QueryResult World::operator()(const Common::SoldierQuery& q)
 
 	SoldierQueryResult sqr;
 	sqr.soldier = *sd;
+	hide(sqr.soldier, q.viewer);
 	return sqr;
 }
 
@@ -85,6 +215,29 @@ Common::QueryResult World::operator()(const Common::CurrentSoldierQuery& q)
 	return sqr;
 }
 
+Common::QueryResult World::operator()(const Common::SnapshotQuery& q)
+{
+	SnapshotQueryResult sqr;
+	for(unsigned int i = 0; i < sqr.teams.size(); i++) {
+		TeamData* td = mData->getTeam(TeamID(i + 1));
+		assert(td);
+		sqr.teams[i] = *td;
+	}
+	for(unsigned int i = 0; i < sqr.soldiers.size(); i++) {
+		SoldierData* sd = mData->getSoldier(SoldierID(i + 1));
+		assert(sd);
+		sqr.soldiers[i] = *sd;
+		hide(sqr.soldiers[i], q.viewer);
+	}
+	sqr.currentteam = mData->getCurrentTeamID();
+	sqr.currentsoldier = mData->getCurrentSoldierID();
+	if(q.includemap) {
+		sqr.hasmap = true;
+		sqr.map = *mData->getMapData();
+	}
+	return sqr;
+}
+
 Common::QueryResult World::operator()(const Common::MovementInput& i)
 {
 	/* TODO: check client */
@@ -92,12 +245,18 @@ Common::QueryResult World::operator()(const Common::MovementInput& i)
 		return DeniedQueryResult();
 	}
 
+	unsigned int teams;
+	{
+		auto sd = mData->getSoldier(i.mover);
+		assert(sd);
+		teams = teamMask(sd->teamid) | seenBy(sd->position) | seenBy(i.to);
+	}
+
 	bool empty = (*mData)(i);
 	assert(!empty);
 
-	for(auto& q : mEventQueue) {
-		q.push(InputEvent(i));
-	}
+	mEventLog.append(InputEvent(i), teams);
+	updateVision(i.mover);
 	return InvalidQueryResult();
 }
 
@@ -112,31 +271,19 @@ Common::QueryResult World::operator()(const Common::ShotInput& i)
 	bool empty = (*mData)(i);
 	assert(!empty);
 
-	Position sp = i.target;
+	Position sp;
+	unsigned int teams;
 	{
 		auto sd = mData->getSoldier(i.shooter);
 		assert(sd);
-		auto l = ::Common::Line::line(::Common::Point2(sd->position.x, sd->position.y),
-				::Common::Point2(i.target.x, i.target.y));
-		assert(l.size() >= 2);
-		l.pop_front(); // shooter position
-		l.pop_front(); // first position next to shooter
-		const auto mapdata = mData->getMapData();
-		for(auto& p : l) {
-			Position pp(p.x, p.y);
-			if(mapdata->positionBlocked(pp) || mData->getSoldierAt(pp)) {
-				sp = pp;
-				break;
-			}
-		}
+		sp = mData->traceShot(sd->position, i.target);
+		teams = teamMask(sd->teamid) | seenBy(sd->position) | seenBy(sp);
 	}
 
 	ShotInput ii(i.shooter, sp);
 
 	/* TODO: add checking for obstacles and range */
-	for(auto& q : mEventQueue) {
-		q.push(InputEvent(ii));
-	}
+	mEventLog.append(InputEvent(ii), teams);
 
 	auto tgtsoldier = mData->getSoldierAt(ii.target);
 	if(tgtsoldier) {
@@ -147,11 +294,10 @@ Common::QueryResult World::operator()(const Common::ShotInput& i)
 		bool empty = (*mData)(ev);
 		assert(!empty);
 
-		for(auto& q : mEventQueue) {
-			q.push(ev);
-		}
+		mEventLog.append(ev, teams | teamMask(tgtsoldier->teamid));
 
 		if(nh.value == 0) {
+			updateVision(tgtsoldier->id);
 			TeamID t = tgtsoldier->teamid;
 			if(mData->teamLost(t)) {
 				static_assert(MAX_NUM_TEAMS == 2, "currently only two teams are supported");
@@ -159,10 +305,9 @@ Common::QueryResult World::operator()(const Common::ShotInput& i)
 
 				bool empty = (*mData)(gwe);
 				assert(!empty);
+				mWinner = gwe.winner;
 
-				for(auto& q : mEventQueue) {
-					q.push(gwe);
-				}
+				mEventLog.append(gwe);
 
 			}
 		}
@@ -177,9 +322,9 @@ Common::QueryResult World::operator()(const Common::FinishTurnInput& i)
 
 	mData->advanceCurrent();
 
-	for(auto& q : mEventQueue) {
-		q.push(InputEvent(i));
-	}
+	mEventLog.append(InputEvent(i));
+	if(mAutosave)
+		mAutosave->turnFinished(*mData);
 	return InvalidQueryResult();
 }
 
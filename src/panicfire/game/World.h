@@ -2,37 +2,79 @@
 #define PANICFIRE_GAME_GAME_H
 
 #include <array>
-#include <queue>
 
 #include "panicfire/common/Structures.h"
+#include "panicfire/game/EventLog.h"
+#include "panicfire/game/Vision.h"
 
 namespace PanicFire {
 
 namespace Game {
 
+class ReplayWriter;
+class Autosave;
+
 class World : public Common::WorldInterface,
 	public boost::static_visitor<Common::QueryResult> {
 
 	public:
-		World();
+		World(uint64_t seed = 0);
+		// plays on the given map instead of a generated one
+		World(const Common::MapData& map, uint64_t seed = 0);
 		~World();
 
 		Common::QueryResult query(const Common::Query& q);
 		bool input(const Common::Input& i);
 		Common::Event pollEvents(Common::TeamID tid);
+		unsigned int pollEvents(Common::TeamID tid, std::vector<Common::Event>& out);
+
+		// spectators read the same event log as the teams. Removing or
+		// polling with anything but a live spectator throws.
+		unsigned int addSpectator();
+		void removeSpectator(unsigned int spectator);
+		unsigned int pollSpectatorEvents(unsigned int spectator, std::vector<Common::Event>& out);
+
+		// team ID 0 while the game is still on
+		Common::TeamID getWinner() const;
+
+		// records all accepted inputs; pass nullptr to stop recording
+		void setReplayWriter(ReplayWriter* r);
+		// gets the state at the end of each turn; nullptr to disable
+		void setAutosave(Autosave* a);
+		const Common::WorldData& getData() const;
+		// replaces the world state, e.g. from a replay keyframe
+		void restore(const Common::WorldData& d);
+		const Vision& getVision() const;
 
 		Common::QueryResult operator()(const Common::SoldierQuery& q);
 		Common::QueryResult operator()(const Common::MapQuery& q);
 		Common::QueryResult operator()(const Common::TeamQuery& q);
 		Common::QueryResult operator()(const Common::CurrentSoldierQuery& q);
+		Common::QueryResult operator()(const Common::SnapshotQuery& q);
 
 		Common::QueryResult operator()(const Common::MovementInput& i);
 		Common::QueryResult operator()(const Common::ShotInput& i);
 		Common::QueryResult operator()(const Common::FinishTurnInput& i);
 
 	private:
+		void checkSpectator(unsigned int spectator) const;
+		// recomputes what the teams see after soldier s moved or died;
+		// the null soldier ID recomputes everything
+		void updateVision(Common::SoldierID s);
+		// event log masks: the team itself, and the teams that see p
+		static unsigned int teamMask(Common::TeamID t);
+		unsigned int seenBy(const Common::Position& p) const;
+		// moves a soldier the viewer doesn't see outside the map
+		void hide(Common::SoldierData& sd, Common::TeamID viewer) const;
+
 		Common::WorldData *mData;
-		std::array<std::queue<Common::Event>, MAX_NUM_TEAMS> mEventQueue;
+		EventLog mEventLog;
+		Vision mVision;
+		std::vector<Common::SightingEvent> mSightings;
+		std::array<unsigned int, MAX_NUM_TEAMS> mTeamReader;
+		Common::TeamID mWinner;
+		ReplayWriter* mReplay;
+		Autosave* mAutosave;
 };
 
 }
@@ -0,0 +1,208 @@
+#include <chrono>
+
+#include "panicfire/game/WorldServer.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+using namespace PanicFire::Common;
+
+Channel::Channel(TeamID t)
+	: team(t),
+	requests(16),
+	replies(16),
+	events(4096)
+{
+}
+
+ChannelClient::ChannelClient(std::shared_ptr<Channel> c)
+	: mChannel(c)
+{
+}
+
+ChannelReply ChannelClient::request(const ChannelRequest& r)
+{
+	while(!mChannel->requests.push(r))
+		std::this_thread::yield();
+
+	ChannelReply* rep;
+	while(!(rep = mChannel->replies.front()))
+		std::this_thread::yield();
+	ChannelReply ret = *rep;
+	mChannel->replies.pop();
+	return ret;
+}
+
+Common::QueryResult ChannelClient::query(const Common::Query& q)
+{
+	ChannelReply rep = request(ChannelRequest(q));
+	QueryResult* qr = boost::get<QueryResult>(&rep);
+	assert(qr);
+	if(!qr)
+		return InvalidQueryResult();
+	return *qr;
+}
+
+bool ChannelClient::input(const Common::Input& i)
+{
+	ChannelReply rep = request(ChannelRequest(i));
+	InputResult* ir = boost::get<InputResult>(&rep);
+	assert(ir);
+	return ir && ir->accepted;
+}
+
+Common::Event ChannelClient::pollEvents(Common::TeamID tid)
+{
+	assert(tid == mChannel->team);
+	Event* ev = mChannel->events.front();
+	if(!ev)
+		return EmptyEvent();
+	Event ret = *ev;
+	mChannel->events.pop();
+	return ret;
+}
+
+unsigned int ChannelClient::pollEvents(Common::TeamID tid, std::vector<Common::Event>& out)
+{
+	assert(tid == mChannel->team);
+	unsigned int num = 0;
+	while(Event* ev = mChannel->events.front()) {
+		out.push_back(*ev);
+		mChannel->events.pop();
+		num++;
+	}
+	return num;
+}
+
+WorldServer::WorldServer(Common::WorldInterface& w)
+	: mWorld(w),
+	mHaveNewChannels(false),
+	mStop(false)
+{
+}
+
+WorldServer::~WorldServer()
+{
+	stop();
+}
+
+std::unique_ptr<ChannelClient> WorldServer::connect(Common::TeamID t)
+{
+	auto c = std::make_shared<Channel>(t);
+	{
+		std::lock_guard<std::mutex> lock(mNewChannelMutex);
+		mNewChannels.push_back(c);
+		mHaveNewChannels = true;
+	}
+	return std::unique_ptr<ChannelClient>(new ChannelClient(c));
+}
+
+void WorldServer::start()
+{
+	assert(!mThread.joinable());
+	mStop = false;
+	mThread = std::thread(&WorldServer::run, this);
+}
+
+void WorldServer::stop()
+{
+	mStop = true;
+	if(mThread.joinable())
+		mThread.join();
+}
+
+void WorldServer::run()
+{
+	unsigned int idle = 0;
+	while(!mStop) {
+		if(poll()) {
+			idle = 0;
+		} else if(++idle < 1000) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+}
+
+bool WorldServer::poll()
+{
+	if(mHaveNewChannels)
+		acceptChannels();
+
+	bool work = false;
+	for(auto& c : mChannels) {
+		while(ChannelRequest* req = c->requests.front()) {
+			mRequestTeam = c->team;
+			ChannelReply rep = boost::apply_visitor(*this, *req);
+			c->requests.pop();
+
+			// events must be queued before the client sees the reply
+			distributeEvents();
+			while(!c->replies.push(rep))
+				std::this_thread::yield();
+			work = true;
+		}
+	}
+
+	distributeEvents();
+	return work;
+}
+
+void WorldServer::acceptChannels()
+{
+	std::lock_guard<std::mutex> lock(mNewChannelMutex);
+	for(auto& c : mNewChannels)
+		mChannels.push_back(c);
+	mNewChannels.clear();
+	mHaveNewChannels = false;
+}
+
+void WorldServer::distributeEvents()
+{
+	for(unsigned int t = 1; t <= MAX_NUM_TEAMS; t++) {
+		bool subscribed = false;
+		for(auto& c : mChannels) {
+			if(c->team == TeamID(t)) {
+				subscribed = true;
+				break;
+			}
+		}
+		// leave events of teams without a channel to other clients
+		if(!subscribed)
+			continue;
+
+		mEvents.clear();
+		if(!mWorld.pollEvents(TeamID(t), mEvents))
+			continue;
+		for(auto& c : mChannels) {
+			if(c->team == TeamID(t)) {
+				for(auto& ev : mEvents)
+					c->backlog.push_back(ev);
+			}
+		}
+	}
+
+	for(auto& c : mChannels) {
+		while(!c->backlog.empty() && c->events.push(c->backlog.front()))
+			c->backlog.pop_front();
+	}
+}
+
+ChannelReply WorldServer::operator()(const Common::Query& q)
+{
+	Query vq = q;
+	setViewer(vq, mRequestTeam);
+	return mWorld.query(vq);
+}
+
+ChannelReply WorldServer::operator()(const Common::Input& i)
+{
+	return InputResult(mWorld.input(i));
+}
+
+}
+
+}
+
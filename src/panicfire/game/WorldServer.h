@@ -0,0 +1,105 @@
+#ifndef PANICFIRE_GAME_WORLDSERVER_H
+#define PANICFIRE_GAME_WORLDSERVER_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/common/RingBuffer.h"
+#include "panicfire/common/SpscQueue.h"
+
+namespace PanicFire {
+
+namespace Game {
+
+struct InputResult {
+	InputResult(bool a = false) : accepted(a) { }
+	bool accepted;
+};
+
+typedef boost::variant<Common::Query, Common::Input> ChannelRequest;
+typedef boost::variant<Common::QueryResult, InputResult> ChannelReply;
+
+// Queues between one client thread and the server thread. Each queue
+// has a single producer and a single consumer, so none of them need
+// locks.
+struct Channel {
+	Channel(Common::TeamID t);
+
+	Common::TeamID team;
+	Common::SpscQueue<ChannelRequest> requests;    // client -> server
+	Common::SpscQueue<ChannelReply> replies;       // server -> client
+	Common::SpscQueue<Common::Event> events;       // server -> client
+	Common::RingBuffer<Common::Event> backlog;     // server only, events that didn't fit
+};
+
+// WorldInterface for a client running on another thread than the
+// server. query() and input() block until the server has replied; the
+// events caused by a request are queued to the client before the
+// reply, so pollEvents() sees them once the call returns.
+class ChannelClient : public Common::WorldInterface {
+	public:
+		ChannelClient(std::shared_ptr<Channel> c);
+
+		Common::QueryResult query(const Common::Query& q);
+		bool input(const Common::Input& i);
+		Common::Event pollEvents(Common::TeamID tid);
+		unsigned int pollEvents(Common::TeamID tid, std::vector<Common::Event>& out);
+
+	private:
+		ChannelReply request(const ChannelRequest& r);
+
+		std::shared_ptr<Channel> mChannel;
+};
+
+// Serves a WorldInterface to clients on other threads. The server
+// loop is the only thread touching the world; each client talks to it
+// through its own set of lock-free single producer, single consumer
+// queues, which the loop polls in turn.
+class WorldServer : public boost::static_visitor<ChannelReply> {
+	public:
+		WorldServer(Common::WorldInterface& w);
+		~WorldServer();
+
+		// may be called from any thread, also while the server is running
+		std::unique_ptr<ChannelClient> connect(Common::TeamID t);
+
+		// runs the server loop on a new thread
+		void start();
+		void stop();
+
+		// one iteration of the server loop, returns true if there was
+		// anything to do
+		bool poll();
+
+		ChannelReply operator()(const Common::Query& q);
+		ChannelReply operator()(const Common::Input& i);
+
+	private:
+		void run();
+		void acceptChannels();
+		void distributeEvents();
+
+		Common::WorldInterface& mWorld;
+		std::vector<std::shared_ptr<Channel>> mChannels;
+		std::vector<Common::Event> mEvents;
+		// the team of the channel whose request is being handled
+		Common::TeamID mRequestTeam;
+
+		std::mutex mNewChannelMutex;
+		std::vector<std::shared_ptr<Channel>> mNewChannels;
+		std::atomic<bool> mHaveNewChannels;
+
+		std::thread mThread;
+		std::atomic<bool> mStop;
+};
+
+}
+
+}
+
+#endif
+
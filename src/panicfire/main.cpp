@@ -1,17 +1,34 @@
 #include <stdexcept>
 #include <iostream>
 
+#include "common/Checkpoint.h"
 #include "game/World.h"
+#include "game/WorldServer.h"
+#include "game/Autosave.h"
 #include "ui/Driver.h"
 
 using namespace PanicFire;
 
-int main(void)
+int main(int argc, char** argv)
 {
 	try {
 		Game::World w;
-		UI::Driver d(w);
-		srand(0);
+		if(argc > 1) {
+			// continue a saved game
+			PanicFire::Common::WorldData saved;
+			PanicFire::Common::loadCheckpoint(argv[1], saved);
+			w.restore(saved);
+		}
+		Game::Autosave autosave("panicfire.sav");
+		w.setAutosave(&autosave);
+
+		// the UI and the AI run on their own threads and talk to
+		// the world through the server
+		Game::WorldServer server(w);
+		auto uiworld = server.connect(PanicFire::Common::TeamID(1));
+		auto aiworld = server.connect(PanicFire::Common::TeamID(2));
+		server.start();
+		UI::Driver d(*uiworld, *aiworld);
 		d.run();
 	}
 	catch (std::exception& e) {
@@ -0,0 +1,68 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <iostream>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/common/ChunkedMap.h"
+#include "panicfire/common/MapFile.h"
+
+using namespace PanicFire::Common;
+
+static void usage(const char* pn)
+{
+	std::cerr << "Usage: " << pn << " [-s seed] [-w width] [-h height] [-c] file\n"
+		<< "\tGenerates a map as the game would for the seed and saves it as a map file.\n"
+		<< "\t-c: generate the map a ChunkedMap would for the seed\n";
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int seed = 0;
+	unsigned int width = 24;
+	unsigned int height = 24;
+	bool chunked = false;
+	const char* path = nullptr;
+
+	for(int i = 1; i < argc; i++) {
+		if(i + 1 < argc && !strcmp(argv[i], "-s")) {
+			seed = atoi(argv[++i]);
+		} else if(i + 1 < argc && !strcmp(argv[i], "-w")) {
+			width = atoi(argv[++i]);
+		} else if(i + 1 < argc && !strcmp(argv[i], "-h")) {
+			height = atoi(argv[++i]);
+		} else if(!strcmp(argv[i], "-c")) {
+			chunked = true;
+		} else if(!path && argv[i][0] != '-') {
+			path = argv[i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(!path || width == 0 || height == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		MapData m;
+		if(chunked) {
+			// every chunk is visited once, so there's no need to cache any
+			ChunkedMap cm(width, height, seed, 1);
+			m = cm.getRegion(0, 0, width, height);
+		} else {
+			Rng maprng(seed, RngStream::Map);
+			m.generate(width, height, maprng);
+		}
+		saveMapFile(path, m);
+		std::cout << "Saved " << width << "x" << height << " map to " << path << "\n";
+	}
+	catch (std::exception& e) {
+		std::cerr << "std::exception: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
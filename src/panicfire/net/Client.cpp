@@ -0,0 +1,172 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <stdexcept>
+
+#include "panicfire/net/Client.h"
+
+namespace PanicFire {
+
+namespace Net {
+
+using namespace PanicFire::Common;
+
+Client::Client(const std::string& path, uint32_t session, uint64_t seed, TeamID team)
+	: mFd(-1),
+	mInPos(0),
+	mReplyLen(0),
+	mEventPos(0)
+{
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("Client: socket path too long");
+	strcpy(addr.sun_path, path.c_str());
+
+	mFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(mFd < 0)
+		throw std::runtime_error(std::string("Client: socket: ") + strerror(errno));
+	if(connect(mFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+		std::string err = strerror(errno);
+		::close(mFd);
+		throw std::runtime_error("Client: could not connect to " + path + ": " + err);
+	}
+
+	mIn.resize(64 * 1024);
+
+	try {
+		WireWriter w = startRequest(MessageType::Join);
+		w.put32(session);
+		w.put64(seed);
+		w.put8(team.id);
+		w.endFrame();
+		roundTrip(MessageType::Joined);
+	}
+	catch(...) {
+		::close(mFd);
+		throw;
+	}
+}
+
+Client::~Client()
+{
+	::close(mFd);
+}
+
+QueryResult Client::query(const Query& q)
+{
+	WireWriter w = startRequest(MessageType::Query);
+	encode(w, q);
+	w.endFrame();
+	WireReader r = roundTrip(MessageType::QueryReply);
+	QueryResult qr = InvalidQueryResult();
+	decode(r, qr);
+	return qr;
+}
+
+bool Client::input(const Input& i)
+{
+	WireWriter w = startRequest(MessageType::Input);
+	encode(w, i);
+	w.endFrame();
+	WireReader r = roundTrip(MessageType::InputReply);
+	return r.get8() != 0;
+}
+
+Event Client::pollEvents(TeamID tid)
+{
+	if(mEventPos == mEvents.size()) {
+		mEvents.clear();
+		mEventPos = 0;
+		pollEvents(tid, mEvents);
+	}
+	if(mEventPos == mEvents.size())
+		return EmptyEvent();
+	return mEvents[mEventPos++];
+}
+
+unsigned int Client::pollEvents(TeamID tid, std::vector<Event>& out)
+{
+	unsigned int num = 0;
+	// hand out what a single event poll left over first
+	if(&out != &mEvents) {
+		for(; mEventPos < mEvents.size(); mEventPos++, num++)
+			out.push_back(mEvents[mEventPos]);
+	}
+
+	WireWriter w = startRequest(MessageType::PollEvents);
+	w.put8(tid.id);
+	w.endFrame();
+	WireReader r = roundTrip(MessageType::EventsReply);
+	uint32_t count = r.get32();
+	for(uint32_t i = 0; i < count; i++) {
+		out.push_back(EmptyEvent());
+		decode(r, out.back());
+	}
+	return num + count;
+}
+
+WireWriter Client::startRequest(MessageType t)
+{
+	mOut.clear();
+	WireWriter w(mOut);
+	w.beginFrame(t);
+	return w;
+}
+
+WireReader Client::roundTrip(MessageType reply)
+{
+	size_t pos = 0;
+	while(pos < mOut.size()) {
+		ssize_t n = send(mFd, mOut.data() + pos, mOut.size() - pos, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("Client: send: ") + strerror(errno));
+		}
+		pos += n;
+	}
+
+	// drop the previous reply, keep anything after it
+	size_t consumed = mReplyLen ? 4 + mReplyLen : 0;
+	memmove(mIn.data(), mIn.data() + consumed, mInPos - consumed);
+	mInPos -= consumed;
+	mReplyLen = 0;
+
+	uint32_t len;
+	while(!(len = completeFrame(mIn.data(), mInPos))) {
+		if(mInPos >= 4) {
+			// make room for a large reply
+			uint32_t need = 4 + (mIn[0] | (mIn[1] << 8) | (mIn[2] << 16) | (uint32_t(mIn[3]) << 24));
+			if(mIn.size() < need)
+				mIn.resize(need);
+		}
+		ssize_t n = recv(mFd, mIn.data() + mInPos, mIn.size() - mInPos, 0);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("Client: recv: ") + strerror(errno));
+		}
+		if(n == 0)
+			throw std::runtime_error("Client: server closed the connection");
+		mInPos += n;
+	}
+	mReplyLen = len;
+
+	WireReader r(mIn.data() + 4, len);
+	MessageType t = static_cast<MessageType>(r.get8());
+	if(t == MessageType::Error)
+		throw std::runtime_error("Client: server error: " + r.getString());
+	if(t != reply)
+		throw std::runtime_error("Client: unexpected reply");
+	return r;
+}
+
+}
+
+}
+
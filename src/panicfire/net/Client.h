@@ -0,0 +1,55 @@
+#ifndef PANICFIRE_NET_CLIENT_H
+#define PANICFIRE_NET_CLIENT_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/net/Wire.h"
+
+namespace PanicFire {
+
+namespace Net {
+
+// WorldInterface for a world hosted by a Net::Server. Every call is one
+// blocking round trip over the socket; a client object must only be
+// used by one thread at a time. Failures throw std::runtime_error.
+class Client : public Common::WorldInterface {
+	public:
+		// joins the session, creating its world from the seed if it
+		// doesn't exist yet. Team 0 joins as a spectator that sees all
+		// events.
+		Client(const std::string& path, uint32_t session, uint64_t seed,
+				Common::TeamID team);
+		~Client();
+		Client(const Client&) = delete;
+		Client& operator=(const Client&) = delete;
+
+		Common::QueryResult query(const Common::Query& q);
+		bool input(const Common::Input& i);
+		Common::Event pollEvents(Common::TeamID tid);
+		unsigned int pollEvents(Common::TeamID tid, std::vector<Common::Event>& out);
+
+	private:
+		WireWriter startRequest(MessageType t);
+		// sends the request and waits for the reply of the given type
+		WireReader roundTrip(MessageType reply);
+
+		int mFd;
+		std::vector<unsigned char> mOut;
+		std::vector<unsigned char> mIn;
+		size_t mInPos;
+		size_t mReplyLen;
+		// events fetched by a batch poll but not yet handed out
+		std::vector<Common::Event> mEvents;
+		size_t mEventPos;
+};
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,385 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <iostream>
+#include <stdexcept>
+
+#include "panicfire/net/Wire.h"
+#include "panicfire/net/Server.h"
+
+namespace PanicFire {
+
+namespace Net {
+
+using namespace PanicFire::Common;
+
+// drop clients that don't read their replies
+static const size_t MaxPendingOutput = 2 * MaxFrameSize;
+
+// whether a client of the team may send the input at all; the world
+// checks the rest
+static bool inputFromTeam(const Input& i, TeamID team, const WorldData& d)
+{
+	if(auto mi = boost::get<MovementInput>(&i))
+		return WorldData::teamIDFromSoldierID(mi->mover) == team;
+	if(auto si = boost::get<ShotInput>(&i))
+		return WorldData::teamIDFromSoldierID(si->shooter) == team;
+	return d.getCurrentTeamID() == team;
+}
+
+Server::Connection::Connection(int fd_)
+	: fd(fd_),
+	outpos(0),
+	writing(false),
+	sessionid(0),
+	session(nullptr),
+	team(0),
+	spectator(false),
+	spectatorid(0)
+{
+}
+
+Server::Server(const std::string& path, const MapData* map)
+	: mPath(path),
+	mHaveMap(map != nullptr),
+	mMap(map ? *map : MapData()),
+	mListenFd(-1),
+	mEpollFd(-1),
+	mWakeFd(-1),
+	mReadBuf(64 * 1024)
+{
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("Server: socket path too long");
+	strcpy(addr.sun_path, path.c_str());
+
+	mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(mListenFd < 0)
+		throw std::runtime_error(std::string("Server: socket: ") + strerror(errno));
+	unlink(path.c_str());
+	if(bind(mListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+			listen(mListenFd, SOMAXCONN)) {
+		std::string err = strerror(errno);
+		::close(mListenFd);
+		throw std::runtime_error("Server: could not listen on " + path + ": " + err);
+	}
+
+	mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(mEpollFd < 0 || mWakeFd < 0)
+		throw std::runtime_error(std::string("Server: ") + strerror(errno));
+
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = mListenFd;
+	epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mListenFd, &ev);
+	ev.data.fd = mWakeFd;
+	epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev);
+}
+
+Server::~Server()
+{
+	for(auto& c : mConnections)
+		::close(c.second->fd);
+	mConnections.clear();
+	mSessions.clear();
+	if(mWakeFd >= 0)
+		::close(mWakeFd);
+	if(mEpollFd >= 0)
+		::close(mEpollFd);
+	if(mListenFd >= 0) {
+		::close(mListenFd);
+		unlink(mPath.c_str());
+	}
+}
+
+void Server::run()
+{
+	std::vector<epoll_event> events(256);
+	while(1) {
+		int n = epoll_wait(mEpollFd, events.data(), events.size(), -1);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("Server: epoll_wait: ") + strerror(errno));
+		}
+
+		bool stopping = false;
+		for(int i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+			if(fd == mListenFd) {
+				accept();
+				continue;
+			}
+			if(fd == mWakeFd) {
+				uint64_t v;
+				if(read(mWakeFd, &v, sizeof(v)) == sizeof(v))
+					stopping = true;
+				continue;
+			}
+
+			auto it = mConnections.find(fd);
+			if(it == mConnections.end())
+				continue;
+			Connection& c = *it->second;
+			bool ok = true;
+			if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				ok = readFrom(c);
+			if(ok && (events[i].events & EPOLLOUT))
+				ok = writeTo(c);
+			if(!ok)
+				close(c);
+		}
+
+		if(stopping)
+			return;
+	}
+}
+
+void Server::stop()
+{
+	uint64_t v = 1;
+	if(write(mWakeFd, &v, sizeof(v)) != sizeof(v)) {
+		// the counter can't overflow in practice
+	}
+}
+
+unsigned int Server::getNumSessions() const
+{
+	return mSessions.size();
+}
+
+unsigned int Server::getNumConnections() const
+{
+	return mConnections.size();
+}
+
+void Server::accept()
+{
+	while(1) {
+		int fd = accept4(mListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				std::cerr << "Server: accept: " << strerror(errno) << "\n";
+			return;
+		}
+
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev)) {
+			std::cerr << "Server: epoll_ctl: " << strerror(errno) << "\n";
+			::close(fd);
+			continue;
+		}
+		mConnections[fd].reset(new Connection(fd));
+	}
+}
+
+bool Server::readFrom(Connection& c)
+{
+	bool eof = false;
+	while(1) {
+		ssize_t n = read(c.fd, mReadBuf.data(), mReadBuf.size());
+		if(n > 0) {
+			c.in.insert(c.in.end(), mReadBuf.begin(), mReadBuf.begin() + n);
+			if(size_t(n) < mReadBuf.size())
+				break;
+		} else if(n == 0) {
+			eof = true;
+			break;
+		} else {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+	}
+
+	// where the reply to the current frame starts
+	size_t replystart = c.out.size();
+	try {
+		size_t pos = 0;
+		while(1) {
+			uint32_t len = completeFrame(c.in.data() + pos, c.in.size() - pos);
+			if(!len)
+				break;
+			replystart = c.out.size();
+			handleFrame(c, c.in.data() + pos + 4, len);
+			pos += 4 + len;
+		}
+		c.in.erase(c.in.begin(), c.in.begin() + pos);
+	}
+	catch(std::exception& e) {
+		// protocol error - tell the client and hang up. A reply that
+		// was cut short would hide the error frame behind it.
+		std::cerr << "Server: " << e.what() << "\n";
+		c.out.resize(replystart);
+		WireWriter w(c.out);
+		w.beginFrame(MessageType::Error);
+		w.putString(e.what());
+		w.endFrame();
+		writeTo(c);
+		return false;
+	}
+
+	if(eof)
+		return false;
+	return writeTo(c);
+}
+
+bool Server::writeTo(Connection& c)
+{
+	while(c.outpos < c.out.size()) {
+		ssize_t n = send(c.fd, c.out.data() + c.outpos, c.out.size() - c.outpos, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+		c.outpos += n;
+	}
+
+	if(c.outpos == c.out.size()) {
+		c.out.clear();
+		c.outpos = 0;
+	} else if(c.out.size() - c.outpos > MaxPendingOutput) {
+		std::cerr << "Server: client not reading, disconnecting.\n";
+		return false;
+	}
+	updatePoll(c);
+	return true;
+}
+
+void Server::handleFrame(Connection& c, const unsigned char* p, uint32_t len)
+{
+	WireReader r(p, len);
+	MessageType t = static_cast<MessageType>(r.get8());
+	WireWriter w(c.out);
+
+	if(t == MessageType::Join) {
+		if(c.session)
+			throw std::runtime_error("client joined twice");
+		uint32_t sessionid = r.get32();
+		uint64_t seed = r.get64();
+		TeamID team = TeamID(r.get8());
+		join(c, sessionid, seed, team);
+		w.beginFrame(MessageType::Joined);
+		w.endFrame();
+		return;
+	}
+
+	if(!c.session)
+		throw std::runtime_error("request before join");
+	Game::World& world = *c.session->world;
+
+	switch(t) {
+		case MessageType::Query:
+			{
+				Query q = MapQuery();
+				decode(r, q);
+				setViewer(q, c.team);
+				w.beginFrame(MessageType::QueryReply);
+				encode(w, world.query(q));
+				w.endFrame();
+			}
+			break;
+
+		case MessageType::Input:
+			{
+				Input i = FinishTurnInput();
+				decode(r, i);
+				bool accepted = !c.spectator &&
+					inputFromTeam(i, c.team, world.getData()) &&
+					world.input(i);
+				w.beginFrame(MessageType::InputReply);
+				w.put8(accepted);
+				w.endFrame();
+			}
+			break;
+
+		case MessageType::PollEvents:
+			{
+				TeamID team = TeamID(r.get8());
+				if(team != c.team)
+					throw std::runtime_error("events polled for another team");
+				c.events.clear();
+				if(c.spectator)
+					world.pollSpectatorEvents(c.spectatorid, c.events);
+				else
+					world.pollEvents(team, c.events);
+				w.beginFrame(MessageType::EventsReply);
+				w.put32(c.events.size());
+				for(auto& ev : c.events)
+					encode(w, ev);
+				w.endFrame();
+			}
+			break;
+
+		default:
+			throw std::runtime_error("unknown message type");
+	}
+}
+
+void Server::join(Connection& c, uint32_t sessionid, uint64_t seed, TeamID team)
+{
+	if(team.id > MAX_NUM_TEAMS)
+		throw std::runtime_error("invalid team");
+
+	auto it = mSessions.find(sessionid);
+	if(it == mSessions.end())
+		it = mSessions.insert({sessionid, std::unique_ptr<Session>(new Session(seed, mHaveMap ? &mMap : nullptr))}).first;
+
+	c.sessionid = sessionid;
+	c.session = it->second.get();
+	c.session->connections++;
+	c.team = team;
+	if(team.id == 0) {
+		c.spectator = true;
+		c.spectatorid = c.session->world->addSpectator();
+	}
+}
+
+void Server::close(Connection& c)
+{
+	epoll_ctl(mEpollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+	::close(c.fd);
+	if(c.session) {
+		if(c.spectator)
+			c.session->world->removeSpectator(c.spectatorid);
+		if(--c.session->connections == 0)
+			mSessions.erase(c.sessionid);
+	}
+	mConnections.erase(c.fd);
+}
+
+void Server::updatePoll(Connection& c)
+{
+	bool writing = c.outpos < c.out.size();
+	if(writing == c.writing)
+		return;
+	c.writing = writing;
+
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | (writing ? EPOLLOUT : 0);
+	ev.data.fd = c.fd;
+	epoll_ctl(mEpollFd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+}
+
+}
+
@@ -0,0 +1,92 @@
+#ifndef PANICFIRE_NET_SERVER_H
+#define PANICFIRE_NET_SERVER_H
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "panicfire/common/Structures.h"
+#include "panicfire/game/World.h"
+
+namespace PanicFire {
+
+namespace Net {
+
+// Serves any number of worlds over a Unix domain socket, speaking the
+// protocol in panicfire/net/Wire.h. A client joins a session by its number; the
+// first client to join a session creates its world from the given seed
+// and the world is destroyed when the last client leaves.
+//
+// Everything runs on the thread calling run(): one epoll loop over
+// non-blocking sockets, so the worlds need no locking. Requests on one
+// connection are answered in order.
+class Server {
+	public:
+		// if map is given, every session plays on it, otherwise on a
+		// map generated from the session's seed
+		Server(const std::string& path, const Common::MapData* map = nullptr);
+		~Server();
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		// returns after stop() has been called
+		void run();
+		// may be called from any thread or a signal handler
+		void stop();
+
+		unsigned int getNumSessions() const;
+		unsigned int getNumConnections() const;
+
+	private:
+		struct Session {
+			Session(uint64_t seed, const Common::MapData* map)
+				: world(map ? new Game::World(*map, seed) : new Game::World(seed)),
+				connections(0) { }
+			std::unique_ptr<Game::World> world;
+			unsigned int connections;
+		};
+
+		struct Connection {
+			Connection(int fd_);
+			int fd;
+			std::vector<unsigned char> in;
+			std::vector<unsigned char> out;
+			size_t outpos;
+			bool writing; // waiting for EPOLLOUT
+			uint32_t sessionid;
+			Session* session;
+			// the team joined as; events and inputs are limited to it
+			Common::TeamID team;
+			bool spectator;
+			unsigned int spectatorid;
+			std::vector<Common::Event> events;
+		};
+
+		void accept();
+		bool readFrom(Connection& c);
+		bool writeTo(Connection& c);
+		void handleFrame(Connection& c, const unsigned char* p, uint32_t len);
+		void join(Connection& c, uint32_t sessionid, uint64_t seed, Common::TeamID team);
+		void close(Connection& c);
+		void updatePoll(Connection& c);
+
+		std::string mPath;
+		bool mHaveMap;
+		Common::MapData mMap;
+		int mListenFd;
+		int mEpollFd;
+		int mWakeFd;
+		std::map<int, std::unique_ptr<Connection>> mConnections;
+		std::map<uint32_t, std::unique_ptr<Session>> mSessions;
+		std::vector<unsigned char> mReadBuf;
+};
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,485 @@
+#include <string.h>
+
+#include <stdexcept>
+
+#include "panicfire/common/MapCodec.h"
+#include "panicfire/net/Wire.h"
+
+namespace PanicFire {
+
+namespace Net {
+
+using namespace PanicFire::Common;
+
+// WireWriter
+WireWriter::WireWriter(std::vector<unsigned char>& buf)
+	: mBuf(buf),
+	mFrameStart(0)
+{
+}
+
+void WireWriter::beginFrame(MessageType t)
+{
+	mFrameStart = mBuf.size();
+	put32(0);
+	put8(static_cast<uint8_t>(t));
+}
+
+void WireWriter::endFrame()
+{
+	uint32_t len = mBuf.size() - mFrameStart - 4;
+	if(len > MaxFrameSize)
+		throw std::runtime_error("Wire: frame too large");
+	for(int i = 0; i < 4; i++)
+		mBuf[mFrameStart + i] = len >> (i * 8);
+}
+
+void WireWriter::put8(uint8_t v)
+{
+	mBuf.push_back(v);
+}
+
+void WireWriter::put16(uint16_t v)
+{
+	mBuf.push_back(v);
+	mBuf.push_back(v >> 8);
+}
+
+void WireWriter::put32(uint32_t v)
+{
+	for(int i = 0; i < 4; i++)
+		mBuf.push_back(v >> (i * 8));
+}
+
+void WireWriter::put64(uint64_t v)
+{
+	for(int i = 0; i < 8; i++)
+		mBuf.push_back(v >> (i * 8));
+}
+
+void WireWriter::putBytes(const unsigned char* p, unsigned int n)
+{
+	mBuf.insert(mBuf.end(), p, p + n);
+}
+
+void WireWriter::putString(const std::string& s)
+{
+	put32(s.size());
+	putBytes(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+
+// WireReader
+WireReader::WireReader(const unsigned char* p, size_t n)
+	: mPos(p),
+	mEnd(p + n)
+{
+}
+
+const unsigned char* WireReader::need(size_t n)
+{
+	if(size_t(mEnd - mPos) < n)
+		throw std::runtime_error("Wire: truncated message");
+	const unsigned char* p = mPos;
+	mPos += n;
+	return p;
+}
+
+uint8_t WireReader::get8()
+{
+	return *need(1);
+}
+
+uint16_t WireReader::get16()
+{
+	const unsigned char* p = need(2);
+	return p[0] | (p[1] << 8);
+}
+
+uint32_t WireReader::get32()
+{
+	const unsigned char* p = need(4);
+	uint32_t v = 0;
+	for(int i = 3; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+uint64_t WireReader::get64()
+{
+	const unsigned char* p = need(8);
+	uint64_t v = 0;
+	for(int i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+const unsigned char* WireReader::getBytes(size_t n)
+{
+	return need(n);
+}
+
+std::string WireReader::getString()
+{
+	uint32_t n = get32();
+	const unsigned char* p = need(n);
+	return std::string(reinterpret_cast<const char*>(p), n);
+}
+
+size_t WireReader::remaining() const
+{
+	return mEnd - mPos;
+}
+
+// fields
+static void put(WireWriter& w, SoldierID s)
+{
+	w.put8(s.id);
+}
+
+static void put(WireWriter& w, TeamID t)
+{
+	w.put8(t.id);
+}
+
+static void put(WireWriter& w, const Position& p)
+{
+	w.put16(p.x);
+	w.put16(p.y);
+}
+
+static void put(WireWriter& w, const SoldierData& s)
+{
+	put(w, s.id);
+	put(w, s.teamid);
+	put(w, s.position);
+	w.put8(s.health.value);
+	w.put8(static_cast<uint8_t>(s.direction));
+	w.put8(s.aps.value);
+}
+
+static void put(WireWriter& w, const TeamData& t)
+{
+	put(w, t.id);
+	for(auto& s : t.soldiers)
+		put(w, s);
+}
+
+static SoldierID getSoldierID(WireReader& r)
+{
+	return SoldierID(r.get8());
+}
+
+static TeamID getTeamID(WireReader& r)
+{
+	return TeamID(r.get8());
+}
+
+static Position getPosition(WireReader& r)
+{
+	Position p;
+	p.x = r.get16();
+	p.y = r.get16();
+	return p;
+}
+
+static SoldierData getSoldierData(WireReader& r)
+{
+	SoldierData s;
+	s.id = getSoldierID(r);
+	s.teamid = getTeamID(r);
+	s.position = getPosition(r);
+	s.health = Health(r.get8());
+	uint8_t d = r.get8();
+	if(d > static_cast<uint8_t>(Direction::SE))
+		throw std::runtime_error("Wire: invalid direction");
+	s.direction = static_cast<Direction>(d);
+	s.aps = APs(r.get8());
+	return s;
+}
+
+static TeamData getTeamData(WireReader& r)
+{
+	TeamData t;
+	t.id = getTeamID(r);
+	for(auto& s : t.soldiers)
+		s = getSoldierID(r);
+	return t;
+}
+
+// variants
+class Encoder : public boost::static_visitor<> {
+	public:
+		Encoder(WireWriter& w) : mWriter(w) { }
+
+		// queries
+		void operator()(const SoldierQuery& q) { put(mWriter, q.soldier); }
+		void operator()(const MapQuery& q) { }
+		void operator()(const TeamQuery& q) { put(mWriter, q.team); }
+		void operator()(const CurrentSoldierQuery& q) { }
+		void operator()(const SnapshotQuery& q) { mWriter.put8(q.includemap); }
+
+		// inputs
+		void operator()(const MovementInput& i)
+		{
+			put(mWriter, i.mover);
+			put(mWriter, i.from);
+			put(mWriter, i.to);
+		}
+
+		void operator()(const ShotInput& i)
+		{
+			put(mWriter, i.shooter);
+			put(mWriter, i.target);
+		}
+
+		void operator()(const FinishTurnInput& i) { }
+
+		// events
+		void operator()(const InputEvent& ev) { encode(mWriter, ev.input); }
+
+		void operator()(const SightingEvent& ev)
+		{
+			put(mWriter, ev.seer);
+			put(mWriter, ev.seen);
+			mWriter.put8(ev.visible);
+			put(mWriter, ev.position);
+		}
+
+		void operator()(const SoldierWoundedEvent& ev)
+		{
+			put(mWriter, ev.wounded);
+			mWriter.put8(ev.newhealth.value);
+		}
+
+		void operator()(const GameWonEvent& ev) { put(mWriter, ev.winner); }
+		void operator()(const EmptyEvent& ev) { }
+
+		// query results
+		void operator()(const SoldierQueryResult& qr) { put(mWriter, qr.soldier); }
+		void operator()(const MapQueryResult& qr) { encode(mWriter, qr.map); }
+		void operator()(const TeamQueryResult& qr) { put(mWriter, qr.team); }
+
+		void operator()(const CurrentSoldierQueryResult& qr)
+		{
+			put(mWriter, qr.team);
+			put(mWriter, qr.soldier);
+		}
+
+		void operator()(const SnapshotQueryResult& qr)
+		{
+			for(auto& t : qr.teams)
+				put(mWriter, t);
+			for(auto& s : qr.soldiers)
+				put(mWriter, s);
+			put(mWriter, qr.currentteam);
+			put(mWriter, qr.currentsoldier);
+			mWriter.put8(qr.hasmap);
+			if(qr.hasmap)
+				encode(mWriter, qr.map);
+		}
+
+		void operator()(const InvalidQueryResult& qr) { }
+		void operator()(const DeniedQueryResult& qr) { }
+
+	private:
+		WireWriter& mWriter;
+};
+
+template<typename T>
+static void encodeVariant(WireWriter& w, const T& v)
+{
+	w.put8(v.which());
+	Encoder e(w);
+	boost::apply_visitor(e, v);
+}
+
+void encode(WireWriter& w, const Query& q)
+{
+	encodeVariant(w, q);
+}
+
+void encode(WireWriter& w, const Input& i)
+{
+	encodeVariant(w, i);
+}
+
+void encode(WireWriter& w, const Event& ev)
+{
+	encodeVariant(w, ev);
+}
+
+void encode(WireWriter& w, const QueryResult& qr)
+{
+	encodeVariant(w, qr);
+}
+
+void encode(WireWriter& w, const MapData& m)
+{
+	std::vector<unsigned char> buf;
+	encodeMap(m, buf);
+	w.putBytes(buf.data(), buf.size());
+}
+
+void decode(WireReader& r, Query& q)
+{
+	switch(r.get8()) {
+		case 0: q = SoldierQuery(getSoldierID(r)); return;
+		case 1: q = MapQuery(); return;
+		case 2: q = TeamQuery(getTeamID(r)); return;
+		case 3: q = CurrentSoldierQuery(); return;
+		case 4: q = SnapshotQuery(r.get8() != 0); return;
+	}
+	throw std::runtime_error("Wire: invalid query");
+}
+
+void decode(WireReader& r, Input& i)
+{
+	switch(r.get8()) {
+		case 0:
+			{
+				SoldierID s = getSoldierID(r);
+				Position from = getPosition(r);
+				Position to = getPosition(r);
+				i = MovementInput(s, from, to);
+			}
+			return;
+
+		case 1:
+			{
+				SoldierID s = getSoldierID(r);
+				i = ShotInput(s, getPosition(r));
+			}
+			return;
+
+		case 2:
+			i = FinishTurnInput();
+			return;
+	}
+	throw std::runtime_error("Wire: invalid input");
+}
+
+void decode(WireReader& r, Event& ev)
+{
+	switch(r.get8()) {
+		case 0:
+			{
+				Input i = FinishTurnInput();
+				decode(r, i);
+				ev = InputEvent(i);
+			}
+			return;
+
+		case 1:
+			{
+				SightingEvent se;
+				se.seer = getSoldierID(r);
+				se.seen = getSoldierID(r);
+				se.visible = r.get8();
+				se.position = getPosition(r);
+				ev = se;
+			}
+			return;
+
+		case 2:
+			{
+				SoldierID s = getSoldierID(r);
+				ev = SoldierWoundedEvent(s, Health(r.get8()));
+			}
+			return;
+
+		case 3:
+			ev = GameWonEvent(getTeamID(r));
+			return;
+
+		case 4:
+			ev = EmptyEvent();
+			return;
+	}
+	throw std::runtime_error("Wire: invalid event");
+}
+
+void decode(WireReader& r, QueryResult& qr)
+{
+	switch(r.get8()) {
+		case 0:
+			{
+				SoldierQueryResult sqr;
+				sqr.soldier = getSoldierData(r);
+				qr = sqr;
+			}
+			return;
+
+		case 1:
+			{
+				MapQueryResult mqr;
+				decode(r, mqr.map);
+				qr = mqr;
+			}
+			return;
+
+		case 2:
+			{
+				TeamQueryResult tqr;
+				tqr.team = getTeamData(r);
+				qr = tqr;
+			}
+			return;
+
+		case 3:
+			{
+				CurrentSoldierQueryResult cqr;
+				cqr.team = getTeamID(r);
+				cqr.soldier = getSoldierID(r);
+				qr = cqr;
+			}
+			return;
+
+		case 4:
+			{
+				SnapshotQueryResult sqr;
+				for(auto& t : sqr.teams)
+					t = getTeamData(r);
+				for(auto& s : sqr.soldiers)
+					s = getSoldierData(r);
+				sqr.currentteam = getTeamID(r);
+				sqr.currentsoldier = getSoldierID(r);
+				sqr.hasmap = r.get8() != 0;
+				if(sqr.hasmap)
+					decode(r, sqr.map);
+				qr = sqr;
+			}
+			return;
+
+		case 5:
+			qr = InvalidQueryResult();
+			return;
+
+		case 6:
+			qr = DeniedQueryResult();
+			return;
+	}
+	throw std::runtime_error("Wire: invalid query result");
+}
+
+void decode(WireReader& r, MapData& m)
+{
+	const unsigned char* p = r.getBytes(0);
+	r.getBytes(decodeMap(p, r.remaining(), m));
+}
+
+uint32_t completeFrame(const unsigned char* buf, size_t n)
+{
+	if(n < 4)
+		return 0;
+	uint32_t len = buf[0] | (buf[1] << 8) | (buf[2] << 16) | (uint32_t(buf[3]) << 24);
+	if(len == 0 || len > MaxFrameSize)
+		throw std::runtime_error("Wire: invalid frame length");
+	if(n - 4 < len)
+		return 0;
+	return len;
+}
+
+}
+
+}
+
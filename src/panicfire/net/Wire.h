@@ -0,0 +1,103 @@
+#ifndef PANICFIRE_NET_WIRE_H
+#define PANICFIRE_NET_WIRE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Net {
+
+// Binary encoding of the WorldInterface traffic. All integers are
+// little endian and as narrow as the game allows: IDs, health and APs
+// take one byte, coordinates two. Variants are written as a one byte
+// index followed by the fields of the alternative.
+//
+// On a stream every message is a frame: a 32 bit payload length, then
+// the payload starting with a MessageType byte.
+
+enum class MessageType : uint8_t {
+	// client to server
+	Join = 1,	// session (u32), seed (u64), team (u8, 0 for a spectator)
+	Query,		// Query
+	Input,		// Input
+	PollEvents,	// team (u8)
+
+	// server to client
+	Joined = 0x81,	// nothing
+	QueryReply,	// QueryResult
+	InputReply,	// accepted (u8)
+	EventsReply,	// count (u32), Events
+	Error		// message (string)
+};
+
+// largest payload either side accepts
+static const uint32_t MaxFrameSize = 16 * 1024 * 1024;
+
+class WireWriter {
+	public:
+		WireWriter(std::vector<unsigned char>& buf);
+
+		// starts a frame, the length is filled in by endFrame
+		void beginFrame(MessageType t);
+		void endFrame();
+
+		void put8(uint8_t v);
+		void put16(uint16_t v);
+		void put32(uint32_t v);
+		void put64(uint64_t v);
+		void putBytes(const unsigned char* p, unsigned int n);
+		void putString(const std::string& s);
+
+	private:
+		std::vector<unsigned char>& mBuf;
+		size_t mFrameStart;
+};
+
+// reads from a complete payload; throws std::runtime_error when reading
+// past its end
+class WireReader {
+	public:
+		WireReader(const unsigned char* p, size_t n);
+
+		uint8_t get8();
+		uint16_t get16();
+		uint32_t get32();
+		uint64_t get64();
+		const unsigned char* getBytes(size_t n);
+		std::string getString();
+		size_t remaining() const;
+
+	private:
+		const unsigned char* need(size_t n);
+
+		const unsigned char* mPos;
+		const unsigned char* mEnd;
+};
+
+void encode(WireWriter& w, const Common::Query& q);
+void encode(WireWriter& w, const Common::Input& i);
+void encode(WireWriter& w, const Common::Event& ev);
+void encode(WireWriter& w, const Common::QueryResult& qr);
+void encode(WireWriter& w, const Common::MapData& m);
+
+void decode(WireReader& r, Common::Query& q);
+void decode(WireReader& r, Common::Input& i);
+void decode(WireReader& r, Common::Event& ev);
+void decode(WireReader& r, Common::QueryResult& qr);
+void decode(WireReader& r, Common::MapData& m);
+
+// returns the payload length if buf holds a complete frame, 0 if not;
+// throws std::runtime_error if the frame is too large
+uint32_t completeFrame(const unsigned char* buf, size_t n);
+
+}
+
+}
+
+#endif
+
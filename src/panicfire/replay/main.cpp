@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+
+#include "panicfire/game/World.h"
+#include "panicfire/game/Replay.h"
+
+using namespace PanicFire;
+using namespace PanicFire::Common;
+
+static void usage(const char* pn)
+{
+	std::cerr << "Usage: " << pn << " [-i] [-t turn] file\n"
+		<< "\t-i: only print information about the replay\n"
+		<< "\t-t: seek to the start of the given turn and print the state there\n";
+}
+
+static void printInfo(const Game::ReplayReader& r)
+{
+	std::cout << "Seed: " << r.getSeed() << "\n";
+	std::cout << "Turns: " << r.getNumTurns() << "\n";
+	std::cout << "Inputs: " << r.getNumInputs() << "\n";
+	std::cout << "Keyframes: " << r.getKeyframes().size() << "\n";
+	if(r.isComplete())
+		std::cout << "Winner: " << r.getWinner().id << "\n";
+	else
+		std::cout << "Incomplete recording\n";
+}
+
+static void printState(const WorldData& d)
+{
+	std::cout << "Current soldier: " << d.getCurrentSoldierID().id
+		<< " (team " << d.getCurrentTeamID().id << ")\n";
+	for(unsigned int i = 1; i <= MAX_NUM_TEAMS * MAX_TEAM_SOLDIERS; i++) {
+		auto sd = d.getSoldier(SoldierID(i));
+		if(!sd || !sd->id.id)
+			continue;
+		std::cout << "Soldier " << sd->id.id << " (team " << sd->teamid.id << "): "
+			<< sd->position << ", health " << sd->health.value
+			<< ", APs " << sd->aps.value << "\n";
+	}
+}
+
+// re-simulates the whole replay as fast as possible
+static int play(Game::ReplayReader& r, Game::World& w)
+{
+	auto start = std::chrono::steady_clock::now();
+	r.seek(w, 0);
+
+	uint64_t inputs = 0;
+	Input i = FinishTurnInput();
+	std::vector<Event> events;
+	while(r.next(i)) {
+		if(!w.input(i)) {
+			std::cerr << "Input " << inputs << " denied in turn " << r.getTurn()
+				<< " - replay out of sync.\n";
+			return 1;
+		}
+		inputs++;
+
+		// nobody reads the events, don't let them pile up
+		if(boost::get<FinishTurnInput>(&i)) {
+			for(unsigned int t = 1; t <= MAX_NUM_TEAMS; t++) {
+				events.clear();
+				w.pollEvents(TeamID(t), events);
+			}
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(end - start).count();
+	std::cout << "Replayed " << inputs << " inputs (" << r.getTurn() << " turns) in "
+		<< secs << " s\n";
+	if(secs > 0.0)
+		std::cout << inputs / secs << " inputs/s\n";
+	std::cout << "Winner: " << w.getWinner().id << "\n";
+
+	if(r.isComplete() && w.getWinner() != r.getWinner()) {
+		std::cerr << "Winner differs from the recording (" << r.getWinner().id << ").\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool info = false;
+	bool seek = false;
+	unsigned int turn = 0;
+	const char* path = nullptr;
+
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-i")) {
+			info = true;
+		} else if(i + 1 < argc && !strcmp(argv[i], "-t")) {
+			seek = true;
+			turn = atoi(argv[++i]);
+		} else if(argv[i][0] != '-' && !path) {
+			path = argv[i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(!path) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		Game::ReplayReader r(path);
+		if(info) {
+			printInfo(r);
+			return 0;
+		}
+
+		Game::World w(r.getSeed());
+		if(seek) {
+			auto start = std::chrono::steady_clock::now();
+			unsigned int reached = r.seek(w, turn);
+			auto end = std::chrono::steady_clock::now();
+			std::cout << "Turn " << reached << " reached in "
+				<< std::chrono::duration<double>(end - start).count() << " s\n";
+			printState(w.getData());
+			return 0;
+		}
+
+		return play(r, w);
+	}
+	catch (std::exception& e) {
+		std::cerr << "std::exception: " << e.what() << "\n";
+		return 1;
+	}
+	catch(...) {
+		std::cerr << "Unknown exception.\n";
+		return 1;
+	}
+	return 0;
+}
+
@@ -0,0 +1,65 @@
+#include <signal.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <iostream>
+
+#include "panicfire/common/MapFile.h"
+#include "panicfire/net/Server.h"
+
+using namespace PanicFire;
+
+static Net::Server* server = nullptr;
+
+static void onSignal(int)
+{
+	if(server)
+		server->stop();
+}
+
+static void usage(const char* pn)
+{
+	std::cerr << "Usage: " << pn << " [-s socket path] [-m map file]\n"
+		<< "\t-m: play all sessions on the map in the file instead of generated maps\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string path = "panicfire.sock";
+	const char* mapfile = nullptr;
+
+	for(int i = 1; i < argc; i++) {
+		if(i + 1 < argc && !strcmp(argv[i], "-s")) {
+			path = argv[++i];
+		} else if(i + 1 < argc && !strcmp(argv[i], "-m")) {
+			mapfile = argv[++i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	try {
+		// all sessions share the mapping
+		PanicFire::Common::MapData map;
+		if(mapfile)
+			map = PanicFire::Common::loadMapFile(mapfile);
+		Net::Server s(path, mapfile ? &map : nullptr);
+		server = &s;
+		signal(SIGINT, onSignal);
+		signal(SIGTERM, onSignal);
+		std::cout << "Listening on " << path << "\n";
+		s.run();
+		server = nullptr;
+	}
+	catch (std::exception& e) {
+		std::cerr << "std::exception: " << e.what() << "\n";
+		return 1;
+	}
+	catch(...) {
+		std::cerr << "Unknown exception.\n";
+		return 1;
+	}
+	return 0;
+}
+
@@ -0,0 +1,194 @@
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <exception>
+
+#include "panicfire/game/World.h"
+#include "panicfire/game/WorldServer.h"
+#include "panicfire/game/Replay.h"
+#include "panicfire/ai/AI.h"
+#include "panicfire/net/Client.h"
+
+#include "panicfire/sim/Match.h"
+
+namespace PanicFire {
+
+namespace Sim {
+
+using namespace PanicFire::Common;
+
+static std::unique_ptr<Game::ReplayWriter> startReplay(Game::World& w, unsigned int seed,
+		const std::string& replay)
+{
+	std::unique_ptr<Game::ReplayWriter> rw;
+	if(!replay.empty()) {
+		rw.reset(new Game::ReplayWriter(replay, seed, w.getData()));
+		w.setReplayWriter(rw.get());
+	}
+	return rw;
+}
+
+static std::unique_ptr<Game::World> makeWorld(unsigned int seed, const MapData* map)
+{
+	if(map)
+		return std::unique_ptr<Game::World>(new Game::World(*map, seed));
+	else
+		return std::unique_ptr<Game::World>(new Game::World(seed));
+}
+
+// counts the turns and finds the winner in the events, which all modes
+// watch so that -t cuts the matches at the same point; returns true
+// once the match is over
+static bool countEvents(const std::vector<Event>& events, unsigned int maxturns,
+		MatchResult& res)
+{
+	for(auto& ev : events) {
+		if(res.turns >= maxturns || res.winner.id)
+			break;
+		const InputEvent* ie = boost::get<InputEvent>(&ev);
+		if(ie && boost::get<FinishTurnInput>(&ie->input))
+			res.turns++;
+		const GameWonEvent* gwe = boost::get<GameWonEvent>(&ev);
+		if(gwe)
+			res.winner = gwe->winner;
+	}
+	return res.turns >= maxturns || res.winner.id;
+}
+
+// runs an AI for each team on its own thread and watches the match
+// through the monitor, which polls the events of monitorteam
+static MatchResult playAIThreads(WorldInterface& w1, WorldInterface& w2,
+		WorldInterface& monitor, TeamID monitorteam, unsigned int seed,
+		unsigned int maxturns)
+{
+	static_assert(MAX_NUM_TEAMS == 2, "currently only two teams are supported");
+	// both AIs sync before either moves so that neither sees a move
+	// both in its snapshot and in its events
+	AI::AI ai1(w1, TeamID(1), seed);
+	AI::AI ai2(w2, TeamID(2), seed);
+
+	std::atomic<bool> stop(false);
+	std::exception_ptr error[2];
+	auto runAI = [&](AI::AI* ai, unsigned int index) {
+		try {
+			while(!stop) {
+				ai->act();
+				std::this_thread::yield();
+			}
+		}
+		catch(...) {
+			error[index] = std::current_exception();
+			stop = true;
+		}
+	};
+	std::thread t1(runAI, &ai1, 0);
+	std::thread t2(runAI, &ai2, 1);
+
+	MatchResult res;
+	std::vector<Event> events;
+	try {
+		// the AIs may still play on until they're stopped
+		while(!stop) {
+			events.clear();
+			monitor.pollEvents(monitorteam, events);
+			if(countEvents(events, maxturns, res))
+				break;
+			if(events.empty())
+				std::this_thread::yield();
+		}
+	}
+	catch(...) {
+		stop = true;
+		t1.join();
+		t2.join();
+		throw;
+	}
+
+	stop = true;
+	t1.join();
+	t2.join();
+	for(auto& e : error) {
+		if(e)
+			std::rethrow_exception(e);
+	}
+	return res;
+}
+
+static MatchResult playThreadedMatch(unsigned int seed, unsigned int maxturns,
+		const std::string& replay, const MapData* map)
+{
+	auto wp = makeWorld(seed, map);
+	Game::World& w = *wp;
+	auto rw = startReplay(w, seed, replay);
+	Game::WorldServer server(w);
+	auto c1 = server.connect(TeamID(1));
+	auto c2 = server.connect(TeamID(2));
+	// sees the same events as team 1
+	auto monitor = server.connect(TeamID(1));
+	// syncing goes through the channels, so the server loop has to be
+	// running before the AIs are made
+	server.start();
+
+	MatchResult res = playAIThreads(*c1, *c2, *monitor, TeamID(1), seed, maxturns);
+	server.stop();
+	if(rw)
+		rw->finish(res.winner);
+	return res;
+}
+
+MatchResult playRemoteMatch(const std::string& server, unsigned int seed,
+		unsigned int maxturns)
+{
+	// the monitor joins first so that it sees every event
+	Net::Client monitor(server, seed, seed, TeamID(0));
+	Net::Client c1(server, seed, seed, TeamID(1));
+	Net::Client c2(server, seed, seed, TeamID(2));
+	return playAIThreads(c1, c2, monitor, TeamID(0), seed, maxturns);
+}
+
+MatchResult playMatch(unsigned int seed, unsigned int maxturns, bool threaded,
+		const std::string& replay, const MapData* map)
+{
+	if(threaded)
+		return playThreadedMatch(seed, maxturns, replay, map);
+
+	auto wp = makeWorld(seed, map);
+	Game::World& w = *wp;
+	auto rw = startReplay(w, seed, replay);
+	static_assert(MAX_NUM_TEAMS == 2, "currently only two teams are supported");
+	AI::AI ai1(w, TeamID(1), seed);
+	AI::AI ai2(w, TeamID(2), seed);
+
+	// counts the turns from the events like the other modes do
+	unsigned int monitor = w.addSpectator();
+	MatchResult res;
+	std::vector<Event> events;
+	while(res.turns < maxturns) {
+		QueryResult qr = w.query(CurrentSoldierQuery());
+		const CurrentSoldierQueryResult* cq = boost::get<CurrentSoldierQueryResult>(&qr);
+		assert(cq);
+		if(!cq)
+			break;
+
+		// the AI plays until its turn is over
+		if(cq->team == TeamID(1))
+			ai1.act();
+		else
+			ai2.act();
+
+		events.clear();
+		w.pollSpectatorEvents(monitor, events);
+		if(countEvents(events, maxturns, res))
+			break;
+	}
+	w.removeSpectator(monitor);
+
+	if(rw)
+		rw->finish(res.winner);
+	return res;
+}
+
+}
+
+}
+
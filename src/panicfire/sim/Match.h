@@ -0,0 +1,39 @@
+#ifndef PANICFIRE_SIM_MATCH_H
+#define PANICFIRE_SIM_MATCH_H
+
+#include <string>
+
+#include "panicfire/common/Structures.h"
+
+namespace PanicFire {
+
+namespace Sim {
+
+struct MatchResult {
+	MatchResult() : winner(0), turns(0) { }
+	Common::TeamID winner; // team ID 0 for a draw
+	unsigned int turns;
+};
+
+// Plays one AI vs. AI match without any UI. The match is called
+// a draw if there's no winner after maxturns turns. If threaded is
+// set, the world is served on its own thread and each AI runs on
+// another one, talking to the world through a Game::WorldServer.
+// If replay is given, the match is recorded to that file. If map is
+// given, the match is played on it instead of a map generated from the
+// seed.
+MatchResult playMatch(unsigned int seed, unsigned int maxturns, bool threaded = false,
+		const std::string& replay = std::string(), const Common::MapData* map = nullptr);
+
+// Plays one AI vs. AI match in a world hosted by the Net::Server
+// listening on the given socket. Both AIs and the match monitor are
+// separate clients of the session numbered by the seed.
+MatchResult playRemoteMatch(const std::string& server, unsigned int seed,
+		unsigned int maxturns);
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,117 @@
+#include "panicfire/sim/ThreadPool.h"
+
+namespace PanicFire {
+
+namespace Sim {
+
+ThreadPool::ThreadPool(unsigned int nthreads)
+	: mQueued(0),
+	mPending(0),
+	mNextWorker(0),
+	mStop(false)
+{
+	if(nthreads == 0)
+		nthreads = 1;
+	for(unsigned int i = 0; i < nthreads; i++)
+		mWorkers.push_back(std::unique_ptr<Worker>(new Worker()));
+	for(unsigned int i = 0; i < nthreads; i++)
+		mThreads.push_back(std::thread(&ThreadPool::run, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for(auto& t : mThreads)
+		t.join();
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+	return mThreads.size();
+}
+
+void ThreadPool::submit(const std::function<void()>& task)
+{
+	// count the task before it's visible: a worker that's already
+	// awake may take and finish it before we get to notify
+	unsigned int index;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		index = mNextWorker++ % mWorkers.size();
+		mQueued++;
+		mPending++;
+	}
+
+	{
+		Worker& w = *mWorkers[index];
+		std::lock_guard<std::mutex> lock(w.mMutex);
+		w.mTasks.push_back(task);
+	}
+	mWake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this]() { return mPending == 0; });
+}
+
+void ThreadPool::run(unsigned int index)
+{
+	while(1) {
+		std::function<void()> task;
+		if(!takeTask(index, task)) {
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStop || mQueued > 0; });
+			if(mStop)
+				return;
+			continue;
+		}
+
+		task();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending--;
+		if(mPending == 0)
+			mDone.notify_all();
+	}
+}
+
+bool ThreadPool::takeTask(unsigned int index, std::function<void()>& task)
+{
+	bool found = false;
+	{
+		Worker& w = *mWorkers[index];
+		std::lock_guard<std::mutex> lock(w.mMutex);
+		if(!w.mTasks.empty()) {
+			task = std::move(w.mTasks.back());
+			w.mTasks.pop_back();
+			found = true;
+		}
+	}
+
+	for(unsigned int i = 1; !found && i < mWorkers.size(); i++) {
+		Worker& w = *mWorkers[(index + i) % mWorkers.size()];
+		std::lock_guard<std::mutex> lock(w.mMutex);
+		if(!w.mTasks.empty()) {
+			task = std::move(w.mTasks.front());
+			w.mTasks.pop_front();
+			found = true;
+		}
+	}
+
+	if(found) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueued--;
+	}
+	return found;
+}
+
+}
+
+}
+
@@ -0,0 +1,56 @@
+#ifndef PANICFIRE_SIM_THREADPOOL_H
+#define PANICFIRE_SIM_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace PanicFire {
+
+namespace Sim {
+
+// Work stealing thread pool. Each worker has its own task deque and
+// takes work from its back; idle workers steal from the front of the
+// other workers' deques.
+class ThreadPool {
+	public:
+		ThreadPool(unsigned int nthreads);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		unsigned int getNumThreads() const;
+		void submit(const std::function<void()>& task);
+		// blocks until all submitted tasks have finished
+		void wait();
+
+	private:
+		struct Worker {
+			std::mutex mMutex;
+			std::deque<std::function<void()>> mTasks;
+		};
+
+		void run(unsigned int index);
+		bool takeTask(unsigned int index, std::function<void()>& task);
+
+		std::vector<std::unique_ptr<Worker>> mWorkers;
+		std::vector<std::thread> mThreads;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		std::condition_variable mDone;
+		unsigned int mQueued;
+		unsigned int mPending;
+		unsigned int mNextWorker;
+		bool mStop;
+};
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <mutex>
+
+#include "panicfire/sim/ThreadPool.h"
+#include "panicfire/sim/Tournament.h"
+
+namespace PanicFire {
+
+namespace Sim {
+
+TournamentResult::TournamentResult()
+	: matches(0),
+	errors(0),
+	turns(0)
+{
+	wins.fill(0);
+}
+
+void TournamentResult::add(const MatchResult& r)
+{
+	matches++;
+	turns += r.turns;
+	assert(r.winner.id < wins.size());
+	wins[r.winner.id]++;
+}
+
+void TournamentResult::add(const TournamentResult& r)
+{
+	matches += r.matches;
+	errors += r.errors;
+	turns += r.turns;
+	for(unsigned int i = 0; i < wins.size(); i++)
+		wins[i] += r.wins[i];
+}
+
+TournamentResult playTournament(unsigned int seed, unsigned int nmatches,
+		unsigned int maxturns, unsigned int nthreads, bool threadedmatches,
+		const std::string& server, const Common::MapData* map)
+{
+	TournamentResult total;
+	std::mutex totalmutex;
+	ThreadPool pool(nthreads);
+
+	// a few batches per thread so that stealing can even out the load
+	// without paying for a task per match
+	unsigned int batch = std::max(1u, nmatches / (pool.getNumThreads() * 8));
+
+	for(unsigned int first = 0; first < nmatches; first += batch) {
+		unsigned int last = std::min(nmatches, first + batch);
+		pool.submit([&, first, last]() {
+			TournamentResult local;
+			for(unsigned int i = first; i < last; i++) {
+				try {
+					if(server.empty())
+						local.add(playMatch(seed + i, maxturns, threadedmatches,
+								std::string(), map));
+					else
+						local.add(playRemoteMatch(server, seed + i, maxturns));
+				}
+				catch (std::exception& e) {
+					std::cerr << "Match " << seed + i << " failed: " << e.what() << "\n";
+					local.errors++;
+				}
+			}
+			std::lock_guard<std::mutex> lock(totalmutex);
+			total.add(local);
+		});
+	}
+
+	pool.wait();
+	return total;
+}
+
+}
+
+}
+
@@ -0,0 +1,38 @@
+#ifndef PANICFIRE_SIM_TOURNAMENT_H
+#define PANICFIRE_SIM_TOURNAMENT_H
+
+#include <array>
+#include <string>
+
+#include "panicfire/sim/Match.h"
+
+namespace PanicFire {
+
+namespace Sim {
+
+struct TournamentResult {
+	TournamentResult();
+	void add(const MatchResult& r);
+	void add(const TournamentResult& r);
+
+	unsigned int matches;
+	unsigned int errors;
+	unsigned long long turns;
+	std::array<unsigned int, MAX_NUM_TEAMS + 1> wins; // index 0 for draws
+};
+
+// Plays nmatches matches with seeds seed, seed + 1, ... spread over
+// nthreads worker threads. The result only depends on the seed, not on
+// the number of threads. If server is given, the matches are played in
+// worlds hosted by the Net::Server listening on that socket. Otherwise,
+// if map is given, all matches are played on it.
+TournamentResult playTournament(unsigned int seed, unsigned int nmatches,
+		unsigned int maxturns, unsigned int nthreads, bool threadedmatches = false,
+		const std::string& server = std::string(), const Common::MapData* map = nullptr);
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+#include "panicfire/common/MapFile.h"
+#include "panicfire/sim/Match.h"
+#include "panicfire/sim/Tournament.h"
+
+using namespace PanicFire;
+
+static void usage(const char* pn)
+{
+	std::cerr << "Usage: " << pn << " [-n matches] [-s seed] [-t max turns] [-j threads] [-c] [-r file] [-u socket] [-m map file]\n"
+		<< "\t-c: run each AI on its own thread, talking to the world through channels\n"
+		<< "\t-r: play a single match with the given seed and record it to file\n"
+		<< "\t-u: play the matches on the panicfire-server listening on socket\n"
+		<< "\t-m: play on the map in the file instead of maps generated from the seeds\n";
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int nmatches = 100;
+	unsigned int seed = 0;
+	unsigned int maxturns = 1000;
+	unsigned int nthreads = std::thread::hardware_concurrency();
+	bool threadedmatches = false;
+	const char* replay = nullptr;
+	const char* server = "";
+	const char* mapfile = nullptr;
+
+	for(int i = 1; i < argc; i++) {
+		if(i + 1 < argc && !strcmp(argv[i], "-n")) {
+			nmatches = atoi(argv[++i]);
+		} else if(i + 1 < argc && !strcmp(argv[i], "-s")) {
+			seed = atoi(argv[++i]);
+		} else if(i + 1 < argc && !strcmp(argv[i], "-t")) {
+			maxturns = atoi(argv[++i]);
+		} else if(i + 1 < argc && !strcmp(argv[i], "-j")) {
+			nthreads = atoi(argv[++i]);
+		} else if(!strcmp(argv[i], "-c")) {
+			threadedmatches = true;
+		} else if(i + 1 < argc && !strcmp(argv[i], "-r")) {
+			replay = argv[++i];
+		} else if(i + 1 < argc && !strcmp(argv[i], "-u")) {
+			server = argv[++i];
+		} else if(i + 1 < argc && !strcmp(argv[i], "-m")) {
+			mapfile = argv[++i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	try {
+		if(nthreads == 0)
+			nthreads = 1;
+
+		if(mapfile && server[0]) {
+			std::cerr << "The map of remote matches is chosen by the server.\n";
+			return 1;
+		}
+		PanicFire::Common::MapData map;
+		if(mapfile)
+			map = PanicFire::Common::loadMapFile(mapfile);
+
+		if(replay) {
+			auto res = Sim::playMatch(seed, maxturns, threadedmatches, replay,
+					mapfile ? &map : nullptr);
+			std::cout << "Recorded " << res.turns << " turns to " << replay << "\n";
+			std::cout << "Winner: " << res.winner.id << "\n";
+			return 0;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto res = Sim::playTournament(seed, nmatches, maxturns, nthreads,
+				threadedmatches, server, mapfile ? &map : nullptr);
+		auto end = std::chrono::steady_clock::now();
+		double secs = std::chrono::duration<double>(end - start).count();
+
+		std::cout << "Played " << res.matches << " matches (" << res.turns << " turns) in "
+			<< secs << " s on " << nthreads << " threads\n";
+		if(secs > 0.0) {
+			std::cout << res.matches / secs << " matches/s, "
+				<< res.turns / secs << " turns/s\n";
+		}
+		for(unsigned int t = 1; t <= MAX_NUM_TEAMS; t++) {
+			std::cout << "Team " << t << " wins: " << res.wins[t] << "\n";
+		}
+		std::cout << "Draws: " << res.wins[0] << "\n";
+		if(res.errors) {
+			std::cout << "Failed matches: " << res.errors << "\n";
+		}
+	}
+	catch (std::exception& e) {
+		std::cerr << "std::exception: " << e.what() << "\n";
+		return 1;
+	}
+	catch(...) {
+		std::cerr << "Unknown exception.\n";
+		return 1;
+	}
+	return 0;
+}
+
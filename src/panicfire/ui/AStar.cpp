@@ -1,6 +1,7 @@
-#include "panicfire/ui/AStar.h"
+#include <algorithm>
+#include <iostream>
 
-#include "common/AStar.h"
+#include "panicfire/ui/AStar.h"
 
 namespace PanicFire {
 
@@ -9,6 +10,11 @@ namespace UI {
 using Common::Position;
 
 AStar::AStar()
+	: mMapData(nullptr),
+	mWidth(0),
+	mHeight(0),
+	mGeneration(0),
+	mExpanded(0)
 {
 }
 
@@ -17,87 +23,142 @@ void AStar::setMapData(const Common::MapData* m)
 	mMapData = m;
 }
 
-std::list<Common::Position> AStar::solve(const std::set<Common::Position>& blocked,
+std::vector<Common::Position> AStar::solve(const Common::Bitset& occupied,
 		const Common::Position& from,
-		const Common::Position& to) const
-{
-	return ::Common::AStar<Common::Position>::solve([&](const Position& p) {
-				return graphFunc(blocked, p);
-			},
-			[&](const Position& a, const Position& b) {
-				return costFunc(a, b);
-			},
-			[&](const Position& a) {
-				return heurFunc(a, to);
-			},
-			[&](const Position& a) {
-				return goalTestFunc(a, to);
-			},
-			from);
-}
-
-std::set<Common::Position> AStar::graphFunc(const std::set<Common::Position>& blocked,
-	const Common::Position& a) const
+		const Common::Position& to,
+		unsigned int maxnodes,
+		std::chrono::steady_clock::time_point deadline)
 {
-	std::set<Common::Position> ret;
+	std::vector<Position> ret;
+	mExpanded = 0;
 
 	if(!mMapData) {
 		std::cerr << "No map data.\n";
 		return ret;
 	}
 
-	if(a.x > 0) {
-		if(a.y > 0) {
-			maybeInsert(ret, blocked, Position(a.x - 1, a.y - 1));
-		}
-		maybeInsert(ret, blocked, Position(a.x - 1, a.y));
-		if(a.y < mMapData->getHeight() - 1) {
-			maybeInsert(ret, blocked, Position(a.x - 1, a.y + 1));
-		}
-	}
-	if(a.x < mMapData->getWidth() - 1) {
-		if(a.y > 0) {
-			maybeInsert(ret, blocked, Position(a.x + 1, a.y - 1));
-		}
-		maybeInsert(ret, blocked, Position(a.x + 1, a.y));
-		if(a.y < mMapData->getHeight() - 1) {
-			maybeInsert(ret, blocked, Position(a.x + 1, a.y + 1));
+	startSearch();
+
+	if(from.x >= mWidth || from.y >= mHeight ||
+			to.x >= mWidth || to.y >= mHeight)
+		return ret;
+
+	assert(occupied.size() == mWidth * mHeight);
+
+	const Common::BitsetView mapblocked = mMapData->getBlockedGrid();
+	const unsigned char* mapcost = mMapData->getCostGrid();
+	const unsigned int start = from.y * mWidth + from.x;
+	const unsigned int goal = to.y * mWidth + to.x;
+
+	mOpen.clear();
+	mCost[start] = 0;
+	mCostGen[start] = mGeneration;
+	mParent[start] = start;
+	mOpen.push_back(OpenNode(heurFunc(start, goal), start));
+
+	// reached tile closest to the goal, used if the search is cut short
+	unsigned int best = start;
+	unsigned int besth = heurFunc(start, goal);
+	const bool checktime = deadline != std::chrono::steady_clock::time_point::max();
+
+	while(!mOpen.empty()) {
+		std::pop_heap(mOpen.begin(), mOpen.end());
+		unsigned int cur = mOpen.back().index;
+		mOpen.pop_back();
+
+		if(mClosedGen[cur] == mGeneration)
+			continue;
+		mClosedGen[cur] = mGeneration;
+
+		if(cur == goal)
+			return buildPath(start, goal);
+
+		if((maxnodes && mExpanded >= maxnodes) ||
+				(checktime && mExpanded && (mExpanded & 63) == 0 &&
+				 std::chrono::steady_clock::now() >= deadline))
+			return buildPath(start, best);
+		mExpanded++;
+
+		const unsigned int cx = cur % mWidth;
+		const unsigned int cy = cur / mWidth;
+		for(int dy = -1; dy <= 1; dy++) {
+			if((dy < 0 && cy == 0) || (dy > 0 && cy == mHeight - 1))
+				continue;
+			for(int dx = -1; dx <= 1; dx++) {
+				if(dx == 0 && dy == 0)
+					continue;
+				if((dx < 0 && cx == 0) || (dx > 0 && cx == mWidth - 1))
+					continue;
+
+				unsigned int n = (cy + dy) * mWidth + cx + dx;
+				if(mClosedGen[n] == mGeneration)
+					continue;
+				if(occupied.test(n) || mapblocked.test(n))
+					continue;
+
+				unsigned int g = mCost[cur] + mapcost[n];
+				if(mCostGen[n] != mGeneration || g < mCost[n]) {
+					mCost[n] = g;
+					mCostGen[n] = mGeneration;
+					mParent[n] = cur;
+					unsigned int h = heurFunc(n, goal);
+					if(h < besth) {
+						best = n;
+						besth = h;
+					}
+					mOpen.push_back(OpenNode(g + h, n));
+					std::push_heap(mOpen.begin(), mOpen.end());
+				}
+			}
 		}
 	}
-	if(a.y > 0) {
-		maybeInsert(ret, blocked, Position(a.x, a.y - 1));
-	}
-	if(a.y < mMapData->getHeight() - 1) {
-		maybeInsert(ret, blocked, Position(a.x, a.y + 1));
-	}
+
 	return ret;
 }
 
-void AStar::maybeInsert(std::set<Common::Position>& s, const std::set<Common::Position>& blocked,
-		const Common::Position& p) const
+unsigned int AStar::getExpandedNodes() const
 {
-	if(!mMapData->positionBlocked(p)) {
-		if(blocked.find(p) == blocked.end()) {
-			s.insert(p);
-		}
-	}
+	return mExpanded;
 }
 
-int AStar::costFunc(const Common::Position& a, const Common::Position& b) const
+std::vector<Common::Position> AStar::buildPath(unsigned int start, unsigned int end) const
 {
-	return mMapData->movementCost(b);
+	std::vector<Position> ret;
+	for(unsigned int i = end; i != start; i = mParent[i])
+		ret.push_back(Position(i % mWidth, i / mWidth));
+	ret.push_back(Position(start % mWidth, start / mWidth));
+	std::reverse(ret.begin(), ret.end());
+	return ret;
 }
 
-int AStar::heurFunc(const Common::Position& from, const Common::Position& to) const
+void AStar::startSearch()
 {
-	int xdiff = abs(int(from.x) - int(to.x));
-	int ydiff = abs(int(from.y) - int(to.y));
-	return xdiff + ydiff;
+	unsigned int w = mMapData->getWidth();
+	unsigned int h = mMapData->getHeight();
+	if(w != mWidth || h != mHeight) {
+		mWidth = w;
+		mHeight = h;
+		mClosedGen.assign(w * h, 0);
+		mCostGen.assign(w * h, 0);
+		mCost.resize(w * h);
+		mParent.resize(w * h);
+		mGeneration = 0;
+	}
+
+	mGeneration++;
+	if(mGeneration == 0) {
+		// wrapped around - old stamps could collide with new ones
+		std::fill(mClosedGen.begin(), mClosedGen.end(), 0);
+		std::fill(mCostGen.begin(), mCostGen.end(), 0);
+		mGeneration = 1;
+	}
 }
 
-bool AStar::goalTestFunc(const Common::Position& node, const Common::Position& goal) const
+unsigned int AStar::heurFunc(unsigned int from, unsigned int to) const
 {
-	return node == goal;
+	int xdiff = abs(int(from % mWidth) - int(to % mWidth));
+	int ydiff = abs(int(from / mWidth) - int(to / mWidth));
+	return xdiff + ydiff;
 }
 
 
@@ -1,34 +1,63 @@
 #ifndef PANICFIRE_UI_ASTAR_H
 #define PANICFIRE_UI_ASTAR_H
 
-#include <list>
-#include <set>
+#include <vector>
+#include <chrono>
 
 #include "panicfire/common/Structures.h"
+#include "panicfire/common/Bitset.h"
 
 namespace PanicFire {
 
 namespace UI {
 
+// Grid A* working on flat tile indices (y * width + x). All search
+// state is kept between calls and invalidated by bumping a generation
+// counter, so a solve doesn't allocate once the buffers have grown to
+// the map size.
 class AStar {
 	public:
 		AStar();
 		void setMapData(const Common::MapData* m);
-		std::list<Common::Position> solve(const std::set<Common::Position>& blocked,
+
+		// occupied holds one bit per tile. The returned path includes
+		// both end points and is empty if no path was found.
+		// maxnodes (0 = no limit) and deadline bound the search; when
+		// either runs out the path leads to the tile found so far that
+		// is closest to the goal instead.
+		std::vector<Common::Position> solve(const Common::Bitset& occupied,
 				const Common::Position& from,
-				const Common::Position& to) const;
+				const Common::Position& to,
+				unsigned int maxnodes = 0,
+				std::chrono::steady_clock::time_point deadline =
+					std::chrono::steady_clock::time_point::max());
+
+		// nodes expanded by the last solve
+		unsigned int getExpandedNodes() const;
 
 	private:
-		const Common::MapData* mMapData;
+		struct OpenNode {
+			OpenNode(unsigned int f_, unsigned int i) : f(f_), index(i) { }
+			unsigned int f;
+			unsigned int index;
+			// inverted so that the std heap functions give a min-heap
+			bool operator<(const OpenNode& oth) const { return f > oth.f; }
+		};
 
-		std::set<Common::Position> graphFunc(const std::set<Common::Position>& blocked,
-				const Common::Position& a) const;
-		int costFunc(const Common::Position& a, const Common::Position& b) const;
-		int heurFunc(const Common::Position& from, const Common::Position& to) const;
-		bool goalTestFunc(const Common::Position& node, const Common::Position& goal) const;
+		void startSearch();
+		unsigned int heurFunc(unsigned int from, unsigned int to) const;
+		std::vector<Common::Position> buildPath(unsigned int start, unsigned int end) const;
 
-		void maybeInsert(std::set<Common::Position>& s, const std::set<Common::Position>& blocked,
-				const Common::Position& p) const;
+		const Common::MapData* mMapData;
+		unsigned int mWidth;
+		unsigned int mHeight;
+		unsigned int mGeneration;
+		unsigned int mExpanded;
+		std::vector<OpenNode> mOpen;
+		std::vector<unsigned int> mClosedGen;
+		std::vector<unsigned int> mCostGen;
+		std::vector<unsigned int> mCost;
+		std::vector<unsigned int> mParent;
 };
 
 }
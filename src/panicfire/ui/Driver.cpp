@@ -296,15 +296,17 @@ void Drawer::drawFrame()
 	const MapData* map = mWorldData->getMapData();
 
 	for(unsigned int j = miny; j < maxy; j++) {
+		unsigned int row = j * map->getWidth();
 		for(unsigned int i = minx; i < maxx; i++) {
-			auto fr = map->getPoint(i, j);
+			auto fr = map->getFragment(row + i);
 			drawGrassTile(i, j, fr.grasslevel);
 		}
 	}
 
 	for(unsigned int j = miny; j < maxy; j++) {
+		unsigned int row = j * map->getWidth();
 		for(unsigned int i = minx; i < maxx; i++) {
-			auto fr = map->getPoint(i, j);
+			auto fr = map->getFragment(row + i);
 			drawVegetationTile(i, j, fr.vegetationlevel);
 		}
 	}
@@ -349,8 +351,9 @@ void Drawer::drawFrame()
 	}
 
 	for(unsigned int j = miny; j < maxy; j++) {
+		unsigned int row = j * map->getWidth();
 		for(unsigned int i = minx; i < maxx; i++) {
-			auto fr = map->getPoint(i, j);
+			auto fr = map->getFragment(row + i);
 			drawVegetationTile(i, j, fr.vegetationlevel);
 		}
 	}
@@ -384,8 +387,9 @@ void Drawer::centerCamera()
 	if(sid.id == 0)
 		sid = mWorldData->getCurrentSoldierID();
 
+	// enemies out of sight are outside the map
 	const SoldierData* sd = mWorldData->getSoldier(sid);
-	if(!sd)
+	if(!sd || !mWorldData->getMapData()->inside(sd->position))
 		return;
 
 	Vector2 p;
@@ -435,12 +439,12 @@ void Drawer::getVisibleMapCoordinates(Position& tl, Position& br) const
 }
 
 // driver
-Driver::Driver(Common::WorldInterface& w)
+Driver::Driver(Common::WorldInterface& w, Common::WorldInterface& aiworld)
 	: ::Common::Driver(800, 600, "Panic Fire"),
 	mWorld(w),
 	mCameraZoomVelocity(0.0f),
 	mMyTeamID(TeamID(1)),
-	mAI(w),
+	mAI(aiworld, TeamID(2), 0, AI::AIBudget(0, std::chrono::milliseconds(10))),
 	mGameOver(false)
 {
 }
@@ -452,7 +456,7 @@ Driver::~Driver()
 bool Driver::init()
 {
 	SDL_utils::setupOrthoScreen(getScreenWidth(), getScreenHeight());
-	if(!mData.sync(mWorld))
+	if(!mData.sync(mWorld, mMyTeamID))
 		return false;
 
 	mAStar.setMapData(mData.getMapData());
@@ -517,10 +521,14 @@ void Driver::sendInput()
 			} else {
 				MovementInput i(mData.getCurrentSoldierID(), sd.position, *pit);
 				if(mData.movementAllowed(i)) {
-					bool succ = mWorld.input(i);
-					assert(succ);
-					mMovementPosition = *pit;
-					mCommandedSoldierID = sd.id;
+					if(mWorld.input(i)) {
+						mMovementPosition = *pit;
+						mCommandedSoldierID = sd.id;
+					} else {
+						/* TODO: display this on GUI instead. */
+						std::cout << "Unable to move.\n";
+						mPathLine.clear();
+					}
 				}
 				break;
 			}
@@ -561,16 +569,19 @@ void Driver::shootAt(const Common::Position& tgtpos)
 
 void Driver::handleEvents()
 {
-	while(1) {
-		auto ev = mWorld.pollEvents(mMyTeamID);
-		bool empty = boost::apply_visitor(mData, ev);
-		if(empty)
-			break;
+	mEvents.clear();
+	mWorld.pollEvents(mMyTeamID, mEvents);
+	for(auto& ev : mEvents) {
+		boost::apply_visitor(mData, ev);
 		boost::apply_visitor(*this, ev);
 	}
 
-	if(mData.getCurrentTeamID() != mMyTeamID) {
-		mAI.act();
+	if(mData.getCurrentTeamID() != mMyTeamID && !mGameOver) {
+		// the AI's turn would never end - stop the game with its error
+		if(mAI.failed())
+			mAI.rethrow();
+		// no-op while the AI is still thinking
+		mAI.startTurn();
 	}
 }
 
@@ -581,7 +592,8 @@ void Driver::operator()(const Common::InputEvent& ev)
 
 void Driver::operator()(const Common::SightingEvent& ev)
 {
-	std::cout << "Sighting!\n";
+	std::cout << "Soldier " << ev.seen.id << (ev.visible ? " sighted by soldier " : " lost by soldier ")
+		<< ev.seer.id << "\n";
 }
 
 void Driver::operator()(const Common::SoldierWoundedEvent& ev)
@@ -611,7 +623,7 @@ void Driver::operator()(const Common::MovementInput& ev)
 void Driver::operator()(const Common::ShotInput& ev)
 {
 	auto sd = mData.getSoldier(ev.shooter);
-	if(sd) {
+	if(sd && mData.getMapData()->inside(sd->position)) {
 		auto from = sd->position;
 		mDrawer.addBulletAnimation(from, ev.target);
 	}
@@ -692,7 +704,7 @@ bool Driver::handleKey(float frameTime, SDLKey key, bool pressed)
 
 void Driver::updateCurrentSoldier()
 {
-	mData.syncCurrentSoldier(mWorld);
+	mData.syncCurrentSoldier(mWorld, mMyTeamID);
 }
 
 }
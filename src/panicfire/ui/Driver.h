@@ -11,7 +11,7 @@
 
 #include "panicfire/common/Structures.h"
 
-#include "panicfire/ai/AI.h"
+#include "panicfire/ai/AsyncAI.h"
 
 #include "panicfire/ui/AStar.h"
 
@@ -107,7 +107,8 @@ class Drawer {
 
 class Driver : public ::Common::Driver, public boost::static_visitor<> {
 	public:
-		Driver(Common::WorldInterface& w);
+		// the AI plays on its own thread through aiworld
+		Driver(Common::WorldInterface& w, Common::WorldInterface& aiworld);
 		~Driver();
 
 		// event handling
@@ -148,8 +149,9 @@ class Driver : public ::Common::Driver, public boost::static_visitor<> {
 		Common::TeamID mMyTeamID;
 		Common::Position mMovementPosition;
 		Common::SoldierID mCommandedSoldierID;
-		AI::AI mAI;
+		AI::AsyncAI mAI;
 		bool mGameOver;
+		std::vector<Common::Event> mEvents;
 };
 
 }